@@ -18,7 +18,9 @@ subject to the following restrictions:
 btTriangleMesh::btTriangleMesh(bool use32bitIndices, bool use4componentVertices)
 	: m_use32bitIndices(use32bitIndices),
 	  m_use4componentVertices(use4componentVertices),
-	  m_weldingThreshold(0.0)
+	  m_weldingCellSize(0.0),
+	  m_weldingThreshold(0.0),
+	  m_useWeldingGrid(true)
 {
 	btIndexedMesh meshIndex;
 	meshIndex.m_numTriangles = 0;
@@ -81,10 +83,97 @@ void btTriangleMesh::addTriangleIndices(int index1, int index2, int index3)
 	addIndex(index3);
 }
 
+btVector3 btTriangleMesh::getVertex(int index) const
+{
+	if (m_use4componentVertices)
+	{
+		return m_4componentVertices[index];
+	}
+	return btVector3(m_3componentVertices[index * 3], m_3componentVertices[index * 3 + 1], m_3componentVertices[index * 3 + 2]);
+}
+
+void btTriangleMesh::weldingCellOf(const btVector3& vertex, long long cell[3]) const
+{
+	for (int k = 0; k < 3; k++)
+	{
+		cell[k] = (long long)floor(vertex[k] / m_weldingCellSize);
+	}
+}
+
+void btTriangleMesh::updateWeldingGrid()
+{
+	//cells are at least as wide as the welding distance, so a match is always in one of the 27 cells around a vertex
+	btScalar cellSize = btMax(btSqrt(m_weldingThreshold), btScalar(1e-3));
+	if (cellSize != m_weldingCellSize)
+	{
+		m_weldingCellSize = cellSize;
+		m_weldingCells.clear();
+		m_weldingCellNext.clear();
+	}
+
+	//vertices added without welding, or before a threshold change, are still candidates
+	int numVertices = m_indexedMeshes[0].m_numVertices;
+	for (int i = m_weldingCellNext.size(); i < numVertices; i++)
+	{
+		long long cell[3];
+		weldingCellOf(getVertex(i), cell);
+		btWeldingCell key((int)cell[0], (int)cell[1], (int)cell[2]);
+		int* head = m_weldingCells.find(key);
+		if (head)
+		{
+			m_weldingCellNext.push_back(*head);
+			*head = i;
+		}
+		else
+		{
+			m_weldingCellNext.push_back(-1);
+			m_weldingCells.insert(key, i);
+		}
+	}
+}
+
+int btTriangleMesh::findWeldedVertex(const btVector3& vertex)
+{
+	updateWeldingGrid();
+
+	long long cell[3];
+	weldingCellOf(vertex, cell);
+
+	//chains run newest first, and the linear scan returns the first match, so keep the lowest index
+	int found = -1;
+	for (int dx = -1; dx <= 1; dx++)
+	{
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dz = -1; dz <= 1; dz++)
+			{
+				const int* head = m_weldingCells.find(btWeldingCell((int)(cell[0] + dx), (int)(cell[1] + dy), (int)(cell[2] + dz)));
+				for (int i = head ? *head : -1; i >= 0; i = m_weldingCellNext[i])
+				{
+					if ((found < 0 || i < found) && (getVertex(i) - vertex).length2() <= m_weldingThreshold)
+					{
+						found = i;
+					}
+				}
+			}
+		}
+	}
+	return found;
+}
+
 int btTriangleMesh::findOrAddVertex(const btVector3& vertex, bool removeDuplicateVertices)
 {
 	//return index of new/existing vertex
-	///@todo: could use acceleration structure for this
+	if (removeDuplicateVertices && m_useWeldingGrid)
+	{
+		int found = findWeldedVertex(vertex);
+		if (found >= 0)
+		{
+			return found;
+		}
+		removeDuplicateVertices = false;
+	}
+
 	if (m_use4componentVertices)
 	{
 		if (removeDuplicateVertices)
@@ -19,6 +19,27 @@ subject to the following restrictions:
 #include "btTriangleIndexVertexArray.h"
 #include "LinearMath/btVector3.h"
 #include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btHashMap.h"
+
+///Key of a btTriangleMesh welding grid cell. Coordinates wrap on overflow, which only makes far apart cells share candidates.
+struct btWeldingCell
+{
+	int m_x, m_y, m_z;
+
+	btWeldingCell(int x, int y, int z) : m_x(x), m_y(y), m_z(z)
+	{
+	}
+
+	bool equals(const btWeldingCell& other) const
+	{
+		return m_x == other.m_x && m_y == other.m_y && m_z == other.m_z;
+	}
+
+	SIMD_FORCE_INLINE unsigned int getHash() const
+	{
+		return btHashInt(m_x * 73856093 ^ m_y * 19349663 ^ m_z * 83492791).getHash();
+	}
+};
 
 ///The btTriangleMesh class is a convenience class derived from btTriangleIndexVertexArray, that provides storage for a concave triangle mesh. It can be used as data for the btBvhTriangleMeshShape.
 ///It allows either 32bit or 16bit indices, and 4 (x-y-z-w) or 3 (x-y-z) component vertices.
@@ -34,8 +55,21 @@ class btTriangleMesh : public btTriangleIndexVertexArray
 	bool m_use32bitIndices;
 	bool m_use4componentVertices;
 
+	//welding grid: cell -> most recently added vertex in it, chained through m_weldingCellNext
+	btHashMap<btWeldingCell, int> m_weldingCells;
+	btAlignedObjectArray<int> m_weldingCellNext;
+	btScalar m_weldingCellSize;
+
+	btVector3 getVertex(int index) const;
+	void weldingCellOf(const btVector3& vertex, long long cell[3]) const;
+	void updateWeldingGrid();
+	int findWeldedVertex(const btVector3& vertex);
+
 public:
 	btScalar m_weldingThreshold;
+	///When set (the default), duplicate vertices are found through a spatial hash instead of scanning every vertex.
+	///Both give the same result: the lowest index within m_weldingThreshold (a squared distance).
+	bool m_useWeldingGrid;
 
 	btTriangleMesh(bool use32bitIndices = true, bool use4componentVertices = true);
 
@@ -5,39 +5,62 @@ in vec4 Color;
 in vec3 Normal;
 
 in vec3 VertexPosition_Worldspace;
-in vec3 LightDirection_Cameraspace;
-in vec3 Normal_Cameraspace;
-in vec3 EyeDirection_cameraspace;
+in vec3 Normal_Worldspace;
+in float ViewDepth;
 
 out vec4 outColor;
 
 //uniform sampler2D tex;
-uniform vec3 lightposition_worldspace;
-uniform vec3 lightcolor;
-uniform float lightpower;
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 proj;
+    vec4 cameraposition_worldspace;
+    vec4 clusterscale; // xy: log view depth to slice, zw: fragment coordinate to tile
+    uvec4 clustercount; // tiles across, tiles up, depth slices
+};
+
+uniform usamplerBuffer clusterlights; // first and count into lightindices, per cluster
+uniform usamplerBuffer lightindices;
+uniform samplerBuffer lights; // per light: position and radius, then color times intensity
 
 void main() {
 
-	//normal of computed fragment (camera space)
-	vec3 n = normalize(Normal_Cameraspace);
-	//direction of light (from fragment to light)
-	vec3 l = normalize(LightDirection_Cameraspace);
+	//normal of computed fragment (world space)
+	vec3 n = normalize(Normal_Worldspace);
 	//eye vector, towards the camera
-	vec3 E = normalize(EyeDirection_cameraspace);
-	//triangle light reflection
-	vec3 R = reflect(-l, n);
+	vec3 E = normalize(cameraposition_worldspace.xyz - VertexPosition_Worldspace);
 
 	vec4 materialdiffuse = Color;
 	vec3 materialambient = vec3(0.5, 0.5, 0.5) * materialdiffuse.xyz;
-	vec3 materialspecular = lightcolor;
-	float distance = length(lightposition_worldspace - VertexPosition_Worldspace);
+	vec3 finalColor = materialambient;
+
+	//find this fragment's cluster: screen tile, then exponential depth slice
+	uint slice = uint(clamp(floor(log(ViewDepth) * clusterscale.x + clusterscale.y), 0.0, float(clustercount.z - 1u)));
+	uvec2 tile = min(uvec2(gl_FragCoord.xy * clusterscale.zw), clustercount.xy - 1u);
+	uint cluster = (slice * clustercount.y + tile.y) * clustercount.x + tile.x;
+	uvec2 range = texelFetch(clusterlights, int(cluster)).xy;
+
+	for (uint i = 0u; i < range.y; i++) {
+		int light = int(texelFetch(lightindices, int(range.x + i)).x);
+		vec4 positionradius = texelFetch(lights, light * 2);
+		vec3 lightcolor = texelFetch(lights, light * 2 + 1).rgb; // already scaled by intensity
+
+		vec3 tolight = positionradius.xyz - VertexPosition_Worldspace;
+		float distance = length(tolight);
+		//direction of light (from fragment to light)
+		vec3 l = tolight / max(distance, 0.0001);
+		//triangle light reflection
+		vec3 R = reflect(-l, n);
+
+		float cosAlpha = clamp(dot(E, R), 0, 1);
+		float cosTheta = clamp(dot(n, l), 0, 1); //clamped in case the light is behind (resulting in neg value)
 
-	float cosAlpha = clamp(dot(E, R), 0, 1);
+		//inverse square, faded to zero at the light's radius so it can be cut off there
+		float fade = clamp(1.0 - pow(distance / positionradius.w, 4.0), 0.0, 1.0);
+		float attenuation = fade * fade / max(distance * distance, 0.01);
 
-	float cosTheta = clamp(dot(n, l), 0, 1); //take the dot product between incoming light and vertex normal, then clamp it to 0-1 in case the light is behind (resulting in neg value)
-	vec3 finalColor = materialdiffuse.xyz * lightcolor * lightpower * cosTheta / (distance * distance)
-		+ materialspecular * lightcolor * lightpower * pow(cosAlpha, 5) / (distance * distance)
-		+ materialambient;
+		finalColor += (materialdiffuse.xyz * cosTheta + pow(cosAlpha, 5)) * lightcolor * attenuation;
+	}
 
 	outColor = vec4(finalColor, materialdiffuse.a);
 };
\ No newline at end of file
@@ -1,46 +1,62 @@
 #version 330 core
 
-in vec3 vertexposition_local;
+in vec4 vertexposition_local; // quantized positions are decoded with positionoffset + position * positionscale
 //in vec2 uv;
-in vec4 color;
-in vec3 normal;
+in vec4 color; // per-instance when the vertex layout has no color
+in vec3 normal; // octahedral encoded in .xy when octahedralnormals is set
+// per-instance, precomputed on the CPU
+in mat4 modelviewproj;
+in mat3x4 model; // each column holds a row of the affine world transform, so vec4(p, 1) * model is p in world space
+in mat3 normalmatrix; // rows of the world normal matrix, the same way
+in vec4 viewdepth; // dot with vec4(p, 1) is the distance in front of the camera
 
 //out vec2 UV;
 out vec3 Normal;
 out vec4 Color;
 
 out vec3 VertexPosition_Worldspace;
-out vec3 LightDirection_Cameraspace;
-out vec3 Normal_Cameraspace;
-out vec3 EyeDirection_cameraspace;
-
-out vec3 LightPosition_worldspace;
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
-
-uniform vec3 lightposition_worldspace;
+out vec3 Normal_Worldspace;
+out float ViewDepth;
+
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 proj;
+    vec4 cameraposition_worldspace;
+    vec4 clusterscale; // xy: log view depth to slice, zw: fragment coordinate to tile
+    uvec4 clustercount; // tiles across, tiles up, depth slices
+};
+
+// per draw: decodes the asset's quantized positions
+layout(std140) uniform DrawData {
+    vec3 positionoffset;
+    vec3 positionscale;
+};
+
+uniform bool octahedralnormals;
+
+vec3 DecodeNormal(vec3 n)
+{
+    if (!octahedralnormals)
+        return n;
+    vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
 
 void main()
 {
+    vec3 position = positionoffset + vertexposition_local.xyz * positionscale;
+    vec3 normal_local = DecodeNormal(normal);
+
     //UV = uv;
-    Normal = normal;
+    Normal = normal_local;
     Color = color;
 
-    gl_Position = proj * view * model * vec4(vertexposition_local, 1); // THE ORDER MATTERS, PLEASE DONT FORGET, FOR THE LOVE OF GOD. P * V * M
-
-    //worldspace position
-    VertexPosition_Worldspace = (model * vec4(vertexposition_local, 1)).xyz;
-
-    //vector from vertex to camera
-    vec3 vertexPosition_cameraspace = (view * model * vec4(vertexposition_local, 1)).xyz;
-    EyeDirection_cameraspace = vec3(0, 0, 0) - vertexPosition_cameraspace;
-
-    //vector from vertex to light
-    vec3 lightposition_cameraspace = (view * vec4(lightposition_worldspace, 1)).xyz;
-    LightDirection_Cameraspace = lightposition_cameraspace + EyeDirection_cameraspace;
+    gl_Position = modelviewproj * vec4(position, 1); // P * V * M, already multiplied
 
-    //normal of vertex
-    Normal_Cameraspace = (view * model * vec4(normal, 0)).xyz;
+    //worldspace position and normal; lights are done per fragment, in world space
+    VertexPosition_Worldspace = vec4(position, 1) * model;
+    Normal_Worldspace = normal_local * normalmatrix;
+    ViewDepth = dot(vec4(position, 1), viewdepth);
 }
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include <iostream>
+
+#include "headers/AssetRegistry.hpp"
+
+unsigned int AssetRegistry::RequestMesh(const char* path, const MeshImportSettings& settings) {
+	// the hash only narrows the search; assets are the same when their settings compare equal
+	std::vector<unsigned int>& candidates = meshLookup[std::string(path) + '|' + std::to_string(meshSettingsHash(settings))];
+	for (unsigned int index : candidates) {
+		if (meshAssets[index]->settings == settings)
+			return index;
+	}
+
+	std::unique_ptr<MeshAsset> asset(new MeshAsset());
+	asset->path = path;
+	asset->settings = settings;
+
+	unsigned int index = (unsigned int)meshAssets.size();
+	meshAssets.push_back(std::move(asset));
+	candidates.push_back(index);
+	return index;
+}
+
+void AssetRegistry::LoadAll(JobSystem& jobs) {
+	JobCounter imported;
+	for (std::unique_ptr<MeshAsset>& asset : meshAssets) {
+		if (asset->loaded)
+			continue;
+
+		MeshAsset* target = asset.get();
+		jobs.Run([target, &jobs]() {
+			target->loaded = importMesh(target->path.c_str(), target->settings, *target, &jobs);
+			if (!target->loaded)
+				std::cout << "Failed to load mesh " << target->path << std::endl;
+		}, &imported);
+	}
+	jobs.Wait(imported);
+}
@@ -0,0 +1,714 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <atomic>
+
+#include "headers/Benchmark.hpp"
+#include "headers/IndexVBO.hpp"
+#include "headers/OBJLoader.hpp"
+#include "headers/RenderQueue.hpp"
+#include "headers/JobSystem.hpp"
+#include "headers/FrustumCuller.hpp"
+#include "headers/OcclusionBuffer.hpp"
+#include "headers/LightGrid.hpp"
+#include "headers/Scene.hpp"
+#include "headers/ObjectPool.hpp"
+#include "headers/FrameArena.hpp"
+
+#include <gtc/matrix_transform.hpp>
+#include "btBulletDynamicsCommon.h"
+
+typedef std::chrono::high_resolution_clock BenchClock;
+
+static double MillisecondsSince(BenchClock::time_point start) {
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+/// <summary>
+/// Builds an unindexed grid of quads in the import vertex layout (position, normal),
+/// with every shared corner repeated the way an OBJ triangle soup would repeat it.
+/// </summary>
+static void GenerateGridSoup(int quadsPerSide, std::vector<float>& out_vbo) {
+	const int vertexSize = VERTEX_SIZE;
+	out_vbo.clear();
+	out_vbo.reserve(quadsPerSide * quadsPerSide * 6 * vertexSize);
+
+	const int corners[6][2] = { {0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1} };
+	for (int x = 0; x < quadsPerSide; x++) {
+		for (int z = 0; z < quadsPerSide; z++) {
+			for (int c = 0; c < 6; c++) {
+				float px = (float)(x + corners[c][0]) * 0.5f;
+				float pz = (float)(z + corners[c][1]) * 0.5f;
+				float vertex[vertexSize] = {
+					px, 0.1f * sinf(px) * cosf(pz), pz,
+					0.0f, 1.0f, 0.0f
+				};
+				out_vbo.insert(out_vbo.end(), vertex, vertex + vertexSize);
+			}
+		}
+	}
+}
+
+static void BenchmarkIndexVBO() {
+	const int vertexSize = VERTEX_SIZE;
+	const int sizes[] = { 16, 64, 100, 408 };
+
+	std::cout << "indexVBO (hash grid vs linear scan)" << std::endl;
+	for (int quadsPerSide : sizes) {
+		std::vector<float> soup;
+		GenerateGridSoup(quadsPerSide, soup);
+		size_t inputVertices = soup.size() / vertexSize;
+
+		std::vector<float> vbo;
+		IndexBuffer indexed;
+		BenchClock::time_point start = BenchClock::now();
+		indexVBO(soup, indexed, vbo, vertexSize);
+		double hashMs = MillisecondsSince(start);
+		size_t hashVertices = vbo.size() / vertexSize;
+
+		std::cout << "  " << inputVertices << " in -> " << hashVertices << " unique : hash "
+			<< hashMs << " ms";
+
+		// The linear path is quadratic (and 16-bit only), so only run it where it finishes in reasonable time.
+		if (hashVertices <= 65535 && inputVertices <= 100000) {
+			std::vector<unsigned short> ebo;
+			vbo.clear();
+			start = BenchClock::now();
+			indexVBOLinear(soup, ebo, vbo, vertexSize);
+			double linearMs = MillisecondsSince(start);
+			std::cout << ", linear " << linearMs << " ms (" << linearMs / hashMs << "x)";
+			if (vbo.size() / vertexSize != hashVertices)
+				std::cout << " MISMATCH: linear found " << vbo.size() / vertexSize << " unique";
+		}
+		std::cout << std::endl;
+	}
+}
+
+/// <summary>
+/// Builds and sorts render commands for random objects spread over a few hundred assets,
+/// and checks the result against std::sort on the same keys.
+/// </summary>
+static void BenchmarkRenderQueue() {
+	const size_t counts[] = { 1000, 10000, 100000, 1000000 };
+	JobSystem jobs;
+
+	std::cout << "RenderQueue (" << jobs.ThreadCount() << " workers)" << std::endl;
+	for (size_t objectCount : counts) {
+		std::mt19937 random(1234);
+		std::vector<glm::vec3> positions(objectCount);
+		std::vector<unsigned int> objectAssets(objectCount);
+		for (size_t i = 0; i < objectCount; i++) {
+			positions[i] = glm::vec3(random() % 1000, random() % 50, random() % 1000) * 0.5f;
+			objectAssets[i] = random() % 300;
+		}
+
+		// roughly what main() does per object: a transform, a distance and a key
+		auto extract = [&](size_t i, InstanceData& out_instance) -> unsigned long long {
+			if (i % 10 == 0)
+				return RenderKey::INVALID; // pretend every tenth object was culled
+			out_instance.modelViewProjection = glm::mat4(1.0f);
+			out_instance.modelViewProjection[3] = glm::vec4(positions[i], 1.0f);
+			out_instance.color = glm::vec4(1.0f);
+			float distance = glm::length(positions[i]);
+			return RenderKey::Make(0, 0, objectAssets[i], (unsigned int)(distance / 100.0f), distance / 1000.0f);
+		};
+
+		RenderQueue queue;
+		BenchClock::time_point start = BenchClock::now();
+		queue.BuildSerial(objectCount, extract);
+		double serialMs = MillisecondsSince(start);
+
+		start = BenchClock::now();
+		queue.Build(jobs, objectCount, extract);
+		double parallelMs = MillisecondsSince(start);
+
+		std::vector<unsigned long long> expected;
+		expected.reserve(objectCount);
+		for (size_t i = 0; i < queue.CommandCount(); i++) {
+			if (queue.Key(i) != RenderKey::INVALID)
+				expected.push_back(queue.Key(i));
+		}
+
+		start = BenchClock::now();
+		queue.Sort();
+		double sortMs = MillisecondsSince(start);
+
+		start = BenchClock::now();
+		std::sort(expected.begin(), expected.end());
+		double stdSortMs = MillisecondsSince(start);
+
+		std::cout << "  " << objectCount << " objects -> " << queue.Groups().size() << " groups : build "
+			<< serialMs << " ms serial, " << parallelMs << " ms parallel; radix sort + group " << sortMs
+			<< " ms, std::sort keys only " << stdSortMs << " ms";
+
+		bool matches = queue.CommandCount() == expected.size();
+		for (size_t i = 0; matches && i < expected.size(); i++)
+			matches = queue.Key(i) == expected[i];
+		if (!matches)
+			std::cout << " MISMATCH: radix sort order differs from std::sort";
+		std::cout << std::endl;
+	}
+}
+
+/// <summary>
+/// Culls boxes scattered over a large level, all static or all dynamic, and checks the visible set
+/// against testing every box on its own.
+/// </summary>
+static void BenchmarkFrustumCuller() {
+	const unsigned int counts[] = { 1000, 10000, 100000 };
+
+	glm::mat4 proj = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1.0f, 2.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum = Frustum::FromMatrix(proj * view);
+
+	std::cout << "FrustumCuller (level 4000 units across, 500 unit far plane)" << std::endl;
+	for (unsigned int objectCount : counts) {
+		std::mt19937 random(99);
+		std::vector<glm::vec3> mins(objectCount), maxs(objectCount);
+		for (unsigned int i = 0; i < objectCount; i++) {
+			mins[i] = glm::vec3((float)(random() % 4000) - 2000.0f, (float)(random() % 20), (float)(random() % 4000) - 2000.0f);
+			maxs[i] = mins[i] + glm::vec3(1.0f + random() % 4);
+		}
+
+		size_t expected = 0;
+		BenchClock::time_point start = BenchClock::now();
+		for (unsigned int i = 0; i < objectCount; i++) {
+			bool inside = true;
+			for (int p = 0; p < 6 && inside; p++) {
+				glm::vec3 center = (mins[i] + maxs[i]) * 0.5f, extent = (maxs[i] - mins[i]) * 0.5f;
+				inside = glm::dot(frustum.normals[p], center) + frustum.offsets[p] + glm::dot(glm::abs(frustum.normals[p]), extent) >= 0.0f;
+			}
+			expected += inside;
+		}
+		double bruteMs = MillisecondsSince(start);
+
+		FrustumCuller staticCuller, dynamicCuller;
+		for (unsigned int i = 0; i < objectCount; i++) {
+			staticCuller.SetStatic(i, mins[i], maxs[i]);
+			dynamicCuller.SetDynamic(i, mins[i], maxs[i]);
+		}
+
+		std::vector<unsigned int> visible;
+		start = BenchClock::now();
+		staticCuller.Cull(frustum, visible);
+		double treeMs = MillisecondsSince(start);
+		size_t treeVisible = visible.size();
+
+		visible.clear();
+		start = BenchClock::now();
+		dynamicCuller.Cull(frustum, visible);
+		double simdMs = MillisecondsSince(start);
+
+		std::cout << "  " << objectCount << " boxes, " << expected << " visible : one by one " << bruteMs
+			<< " ms, btDbvt " << treeMs << " ms, SSE " << simdMs << " ms";
+		if (treeVisible != expected || visible.size() != expected)
+			std::cout << " MISMATCH: tree found " << treeVisible << ", SSE found " << visible.size();
+		std::cout << std::endl;
+	}
+}
+
+/// <summary>
+/// Appends a grid of quads spanning corner to corner + uAxis + vAxis, heights pushed along facing by height(u, v).
+/// Triangles are wound to face along facing, the way the occlusion buffer expects front faces.
+/// </summary>
+template <typename HeightFn>
+static void GenerateOccluderGrid(int quadsPerSide, glm::vec3 corner, glm::vec3 uAxis, glm::vec3 vAxis, glm::vec3 facing,
+	HeightFn height, std::vector<float>& out_vbo, std::vector<unsigned int>& out_indices) {
+	unsigned int first = (unsigned int)(out_vbo.size() / 3);
+	for (int v = 0; v <= quadsPerSide; v++) {
+		for (int u = 0; u <= quadsPerSide; u++) {
+			float fu = (float)u / quadsPerSide, fv = (float)v / quadsPerSide;
+			glm::vec3 p = corner + uAxis * fu + vAxis * fv + facing * height(fu, fv);
+			out_vbo.insert(out_vbo.end(), { p.x, p.y, p.z });
+		}
+	}
+
+	auto position = [&](unsigned int i) { return glm::vec3(out_vbo[i * 3], out_vbo[i * 3 + 1], out_vbo[i * 3 + 2]); };
+	auto addTriangle = [&](unsigned int a, unsigned int b, unsigned int c) {
+		if (glm::dot(glm::cross(position(b) - position(a), position(c) - position(a)), facing) < 0.0f)
+			std::swap(b, c);
+		out_indices.insert(out_indices.end(), { a, b, c });
+	};
+	for (int v = 0; v < quadsPerSide; v++) {
+		for (int u = 0; u < quadsPerSide; u++) {
+			unsigned int i = first + v * (quadsPerSide + 1) + u;
+			addTriangle(i, i + 1, i + quadsPerSide + 2);
+			addTriangle(i, i + quadsPerSide + 2, i + quadsPerSide + 1);
+		}
+	}
+}
+
+/// <summary>
+/// Two headless scenes for the occlusion buffer. A flat wall in front of the camera, where a box is hidden exactly
+/// when all of its corners project inside the wall, so every box the buffer hides is checked against that.
+/// And a hilly terrain seen from just above the ground, timed with boxes scattered over and under the surface.
+/// </summary>
+static void BenchmarkOcclusionBuffer() {
+	const unsigned int boxCount = 10000;
+	glm::mat4 proj = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+
+	std::cout << "OcclusionBuffer (256x144)" << std::endl;
+	{
+		glm::vec3 eye(0.0f, 2.0f, 0.0f);
+		glm::mat4 viewProj = proj * glm::lookAt(eye, glm::vec3(0.0f, 2.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		const float wallZ = 20.0f, wallMinX = -15.0f, wallMaxX = 15.0f, wallMinY = -5.0f, wallMaxY = 12.0f;
+
+		std::vector<float> vbo;
+		std::vector<unsigned int> indices;
+		GenerateOccluderGrid(16, glm::vec3(wallMinX, wallMinY, wallZ), glm::vec3(wallMaxX - wallMinX, 0.0f, 0.0f),
+			glm::vec3(0.0f, wallMaxY - wallMinY, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), [](float, float) { return 0.0f; }, vbo, indices);
+		IndexBuffer ebo;
+		ebo.assign(indices, vbo.size() / 3);
+
+		std::mt19937 random(7);
+		std::vector<glm::vec3> mins(boxCount), maxs(boxCount);
+		unsigned int hidden = 0;
+		std::vector<bool> truthHidden(boxCount);
+		for (unsigned int i = 0; i < boxCount; i++) {
+			mins[i] = glm::vec3((float)(random() % 1000) * 0.08f - 40.0f, (float)(random() % 1000) * 0.03f - 10.0f, 5.0f + (float)(random() % 1000) * 0.1f);
+			maxs[i] = mins[i] + glm::vec3(0.5f + (float)(random() % 100) * 0.03f);
+
+			// project every corner onto the wall's plane through the eye
+			bool behind = mins[i].z > wallZ;
+			for (int c = 0; c < 8 && behind; c++) {
+				glm::vec3 p(c & 1 ? maxs[i].x : mins[i].x, c & 2 ? maxs[i].y : mins[i].y, c & 4 ? maxs[i].z : mins[i].z);
+				glm::vec3 onWall = eye + (p - eye) * ((wallZ - eye.z) / (p.z - eye.z));
+				behind = onWall.x > wallMinX && onWall.x < wallMaxX && onWall.y > wallMinY && onWall.y < wallMaxY;
+			}
+			truthHidden[i] = behind;
+			hidden += behind;
+		}
+
+		OcclusionBuffer buffer;
+		BenchClock::time_point start = BenchClock::now();
+		buffer.RasterizeOccluder(&vbo[0], 3, ebo, 0, (unsigned int)ebo.size(), 0, viewProj);
+		buffer.UpdateHierarchy();
+		double rasterMs = MillisecondsSince(start);
+
+		unsigned int wrong = 0;
+		start = BenchClock::now();
+		for (unsigned int i = 0; i < boxCount; i++) {
+			if (!buffer.IsVisible(mins[i], maxs[i], viewProj) && !truthHidden[i])
+				wrong++;
+		}
+		double testMs = MillisecondsSince(start);
+
+		std::cout << "  wall, " << ebo.size() / 3 << " triangles, " << boxCount << " boxes, " << hidden << " hidden : raster "
+			<< rasterMs << " ms, test " << testMs << " ms, " << buffer.Stats().occluded << " occluded";
+		if (wrong > 0)
+			std::cout << " MISMATCH: " << wrong << " visible boxes occluded";
+		std::cout << std::endl;
+	}
+	{
+		const int sizes[] = { 64, 256 };
+		glm::mat4 viewProj = proj * glm::lookAt(glm::vec3(0.0f, 3.0f, -95.0f), glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		auto hills = [](float u, float v) { return 4.0f * sinf(u * 12.0f) * cosf(v * 9.0f) + 3.0f * sinf(v * 5.0f); };
+
+		for (int quadsPerSide : sizes) {
+			std::vector<float> vbo;
+			std::vector<unsigned int> indices;
+			GenerateOccluderGrid(quadsPerSide, glm::vec3(-100.0f, 0.0f, -100.0f), glm::vec3(200.0f, 0.0f, 0.0f),
+				glm::vec3(0.0f, 0.0f, 200.0f), glm::vec3(0.0f, 1.0f, 0.0f), hills, vbo, indices);
+			IndexBuffer ebo;
+			ebo.assign(indices, vbo.size() / 3);
+
+			std::mt19937 random(11);
+			std::vector<glm::vec3> mins(boxCount), maxs(boxCount);
+			for (unsigned int i = 0; i < boxCount; i++) {
+				float u = (float)(random() % 1000) * 0.001f, v = (float)(random() % 1000) * 0.001f;
+				mins[i] = glm::vec3(u * 200.0f - 100.0f, hills(u, v) + (float)(random() % 100) * 0.04f - 2.0f, v * 200.0f - 100.0f);
+				maxs[i] = mins[i] + glm::vec3(1.0f);
+			}
+
+			OcclusionBuffer buffer;
+			BenchClock::time_point start = BenchClock::now();
+			buffer.RasterizeOccluder(&vbo[0], 3, ebo, 0, (unsigned int)ebo.size(), 0, viewProj);
+			buffer.UpdateHierarchy();
+			double rasterMs = MillisecondsSince(start);
+
+			start = BenchClock::now();
+			for (unsigned int i = 0; i < boxCount; i++)
+				buffer.IsVisible(mins[i], maxs[i], viewProj);
+			double testMs = MillisecondsSince(start);
+
+			std::cout << "  terrain, " << ebo.size() / 3 << " triangles (" << buffer.Stats().occluderTriangles << " rasterized), "
+				<< boxCount << " boxes : raster " << rasterMs << " ms, test " << testMs << " ms, "
+				<< buffer.Stats().occluded << " occluded" << std::endl;
+		}
+	}
+}
+
+/// <summary>
+/// Bins random lights scattered in front of the camera and checks every cluster's list against
+/// testing each light against each cluster one at a time.
+/// </summary>
+static void BenchmarkLightGrid() {
+	const unsigned int counts[] = { 100, 500, 2000 };
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 2.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	LightGrid grid;
+	grid.SetProjection(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+
+	std::cout << "LightGrid (" << LightGrid::TILES_X << "x" << LightGrid::TILES_Y << "x" << LightGrid::SLICES << " clusters)" << std::endl;
+	for (unsigned int lightCount : counts) {
+		std::mt19937 random(5);
+		std::vector<PointLight> lights(lightCount);
+		for (PointLight& light : lights) {
+			light.position = glm::vec3((float)(random() % 2000) * 0.1f - 100.0f, (float)(random() % 100) * 0.1f, -(float)(random() % 2000) * 0.1f);
+			light.intensity = 0.1f + (float)(random() % 100) * 0.01f;
+			light.radius = pointLightRadius(light.intensity);
+			light.color = glm::vec3(1.0f);
+		}
+
+		BenchClock::time_point start = BenchClock::now();
+		std::vector<std::vector<unsigned short>> expected(LightGrid::CLUSTER_COUNT);
+		for (unsigned int l = 0; l < lightCount; l++) {
+			glm::vec3 center = glm::vec3(view * glm::vec4(lights[l].position, 1.0f));
+			for (unsigned int cluster = 0; cluster < LightGrid::CLUSTER_COUNT; cluster++) {
+				glm::vec3 nearest = glm::clamp(center, grid.ClusterMin(cluster), grid.ClusterMax(cluster));
+				if (glm::dot(nearest - center, nearest - center) <= lights[l].radius * lights[l].radius)
+					expected[cluster].push_back((unsigned short)l);
+			}
+		}
+		double bruteMs = MillisecondsSince(start);
+
+		const int runs = 10;
+		LinearArena scratch(64 * 1024);
+		start = BenchClock::now();
+		for (int run = 0; run < runs; run++) {
+			scratch.Reset();
+			grid.Build(lights, view, scratch);
+		}
+		double gridMs = MillisecondsSince(start) / runs;
+
+		size_t mismatched = 0;
+		for (unsigned int cluster = 0; cluster < LightGrid::CLUSTER_COUNT; cluster++) {
+			const unsigned short* first = grid.LightIndices().empty() ? nullptr : &grid.LightIndices()[0] + grid.Clusters()[cluster * 2];
+			unsigned int count = grid.Clusters()[cluster * 2 + 1];
+			if (count != expected[cluster].size() || !std::equal(expected[cluster].begin(), expected[cluster].end(), first))
+				mismatched++;
+		}
+
+		std::cout << "  " << lightCount << " lights, " << grid.LightIndices().size() << " cluster entries : one by one " << bruteMs
+			<< " ms, SSE binning " << gridMs << " ms";
+		if (mismatched > 0)
+			std::cout << " MISMATCH: " << mismatched << " clusters differ";
+		std::cout << std::endl;
+	}
+}
+
+/// <summary>
+/// Walks 100k entities' transforms and colors the way the render systems do, after a round of destroying
+/// and recreating a third of them, against the heap-allocated object per entity the scene used to keep.
+/// Also checks that handles to destroyed entities stop resolving.
+/// </summary>
+static void BenchmarkScene() {
+	const unsigned int entityCount = 100000;
+
+	struct HeapObject {
+		const char* name = "err";
+		bool empty = false;
+		unsigned int meshIndex = 0;
+		unsigned int assetIndex = 0;
+		bool isStatic = false;
+		bool isOccluder = false;
+		glm::vec4 color;
+		btTransform transform;
+	};
+
+	std::mt19937 random(17);
+	auto randomTransform = [&]() {
+		btTransform transform(btQuaternion(btVector3(0, 1, 0), (float)(random() % 628) * 0.01f),
+			btVector3((float)(random() % 1000), (float)(random() % 100), (float)(random() % 1000)));
+		return transform;
+	};
+
+	Scene scene;
+	std::vector<Entity> entities;
+	std::vector<HeapObject*> objects;
+	std::vector<HeapObject*> interleaved; // other allocations between the objects, the way a level's loading would leave them
+	for (unsigned int i = 0; i < entityCount; i++) {
+		Entity entity = scene.Create("entity");
+		btTransform transform = randomTransform();
+		glm::vec4 color((float)(random() % 100) * 0.01f, 0.5f, 0.5f, 1.0f);
+		scene.transforms.Add(entity, transform);
+		scene.renderMeshes.Add(entity);
+		Material material;
+		material.color = color;
+		scene.materials.Add(entity, material);
+		entities.push_back(entity);
+
+		HeapObject* object = new HeapObject();
+		object->transform = transform;
+		object->color = color;
+		objects.push_back(object);
+		interleaved.push_back(new HeapObject());
+	}
+
+	// churn: destroy a third and create as many again, which reuses their slots
+	std::vector<Entity> destroyed;
+	for (unsigned int i = 0; i < entityCount; i += 3) {
+		scene.Destroy(entities[i]);
+		destroyed.push_back(entities[i]);
+		delete objects[i];
+	}
+	for (unsigned int i = 0; i < entityCount; i += 3) {
+		Entity entity = scene.Create("entity");
+		btTransform transform = randomTransform();
+		scene.transforms.Add(entity, transform);
+		scene.renderMeshes.Add(entity);
+		scene.materials.Add(entity, Material{ glm::vec4(0.25f) });
+		entities[i] = entity;
+
+		objects[i] = new HeapObject();
+		objects[i]->transform = transform;
+		objects[i]->color = glm::vec4(0.25f);
+	}
+	std::shuffle(objects.begin(), objects.end(), random);
+
+	size_t stale = 0;
+	for (Entity entity : destroyed)
+		stale += scene.IsAlive(entity) || scene.transforms.Has(entity);
+
+	const int runs = 20;
+	double heapSum = 0.0;
+	BenchClock::time_point start = BenchClock::now();
+	for (int run = 0; run < runs; run++) {
+		for (HeapObject* object : objects) {
+			if (object->empty)
+				continue;
+			heapSum += object->transform.getOrigin().x() + object->color.x;
+		}
+	}
+	double heapMs = MillisecondsSince(start) / runs;
+
+	double sceneSum = 0.0;
+	start = BenchClock::now();
+	for (int run = 0; run < runs; run++) {
+		for (size_t k = 0; k < scene.renderMeshes.Size(); k++) {
+			Entity entity = scene.renderMeshes.EntityAt(k);
+			sceneSum += scene.transforms.Get(entity).getOrigin().x() + scene.materials.Get(entity).color.x;
+		}
+	}
+	double sceneMs = MillisecondsSince(start) / runs;
+
+	std::cout << "Scene (" << entityCount << " entities, a third recreated)" << std::endl;
+	std::cout << "  transform + color pass : heap objects " << heapMs << " ms, component arrays " << sceneMs << " ms";
+	if (stale > 0 || scene.Count() != entityCount || scene.renderMeshes.Size() != entityCount || fabs(heapSum - sceneSum) > fabs(heapSum) * 1e-6)
+		std::cout << " MISMATCH: " << stale << " stale handles resolve, " << scene.Count() << " entities alive";
+	std::cout << std::endl;
+
+	for (HeapObject* object : objects)
+		delete object;
+	for (HeapObject* object : interleaved)
+		delete object;
+}
+
+/// <summary>
+/// Creates and destroys rounds of rigid bodies with their motion states, in a shuffled order, through the
+/// pools and through new and delete. Checks that the pools stop growing after the first round, that
+/// every slot is aligned for Bullet, and that handles to destroyed bodies stop resolving.
+/// </summary>
+static void BenchmarkObjectPool() {
+	const unsigned int bodyCount = 10000;
+	const int rounds = 10;
+
+	btSphereShape shape(1.0f);
+	btVector3 inertia;
+	shape.calculateLocalInertia(1.0f, inertia);
+	std::mt19937 random(23);
+
+	std::vector<unsigned int> order(bodyCount);
+	for (unsigned int i = 0; i < bodyCount; i++)
+		order[i] = i;
+
+	ObjectPool<btDefaultMotionState> motionStates;
+	ObjectPool<btRigidBody> rigidBodies;
+	std::vector<PoolHandle<btDefaultMotionState>> stateHandles(bodyCount);
+	std::vector<PoolHandle<btRigidBody>> bodyHandles(bodyCount);
+	size_t firstRoundCapacity = 0, stale = 0, misaligned = 0;
+
+	double poolMs = 0.0;
+	for (int round = 0; round < rounds; round++) {
+		std::shuffle(order.begin(), order.end(), random);
+		BenchClock::time_point start = BenchClock::now();
+		for (unsigned int i = 0; i < bodyCount; i++) {
+			btTransform transform(btQuaternion::getIdentity(), btVector3((float)i, 0, 0));
+			stateHandles[i] = motionStates.Create(transform);
+			btRigidBody::btRigidBodyConstructionInfo info(1.0f, motionStates.Get(stateHandles[i]), &shape, inertia);
+			bodyHandles[i] = rigidBodies.Create(info);
+			misaligned += ((size_t)rigidBodies.Get(bodyHandles[i]) & 15) != 0;
+		}
+		for (unsigned int i : order) {
+			rigidBodies.Destroy(bodyHandles[i]);
+			motionStates.Destroy(stateHandles[i]);
+		}
+		poolMs += MillisecondsSince(start) / rounds;
+
+		if (round == 0)
+			firstRoundCapacity = rigidBodies.Capacity() + motionStates.Capacity();
+		for (unsigned int i = 0; i < bodyCount; i++)
+			stale += rigidBodies.Get(bodyHandles[i]) != nullptr || motionStates.Get(stateHandles[i]) != nullptr;
+	}
+	size_t grown = rigidBodies.Capacity() + motionStates.Capacity() - firstRoundCapacity;
+
+	std::vector<btDefaultMotionState*> heapStates(bodyCount);
+	std::vector<btRigidBody*> heapBodies(bodyCount);
+	double heapMs = 0.0;
+	for (int round = 0; round < rounds; round++) {
+		std::shuffle(order.begin(), order.end(), random);
+		BenchClock::time_point start = BenchClock::now();
+		for (unsigned int i = 0; i < bodyCount; i++) {
+			btTransform transform(btQuaternion::getIdentity(), btVector3((float)i, 0, 0));
+			heapStates[i] = new btDefaultMotionState(transform);
+			btRigidBody::btRigidBodyConstructionInfo info(1.0f, heapStates[i], &shape, inertia);
+			heapBodies[i] = new btRigidBody(info);
+		}
+		for (unsigned int i : order) {
+			delete heapBodies[i];
+			delete heapStates[i];
+		}
+		heapMs += MillisecondsSince(start) / rounds;
+	}
+
+	std::cout << "ObjectPool (" << bodyCount << " rigid bodies and motion states per round)" << std::endl;
+	std::cout << "  create + destroy : new/delete " << heapMs << " ms, pools " << poolMs << " ms";
+	if (grown > 0 || stale > 0 || misaligned > 0 || rigidBodies.Count() != 0)
+		std::cout << " MISMATCH: grew " << grown << " slots after warm-up, " << stale << " stale handles resolve, " << misaligned << " misaligned";
+	std::cout << std::endl;
+}
+
+/// <summary>
+/// Builds a frame's worth of short-lived lists, sized up front the way the main loop sizes them, once through the heap and once
+/// through a FrameArena, and checks that the arena stops touching the heap after the first frame.
+/// </summary>
+static void BenchmarkFrameArena() {
+	const int frames = 200;
+	const unsigned int listsPerFrame = 64;
+	std::mt19937 random(24);
+	std::vector<unsigned int> lengths(listsPerFrame);
+	for (unsigned int& length : lengths)
+		length = 100 + random() % 1000;
+
+	unsigned long long heapSum = 0;
+	BenchClock::time_point start = BenchClock::now();
+	for (int frame = 0; frame < frames; frame++) {
+		for (unsigned int length : lengths) {
+			std::vector<unsigned int> list;
+			list.reserve(length);
+			for (unsigned int i = 0; i < length; i++)
+				list.push_back(i * frame);
+			heapSum += list[length / 2];
+		}
+	}
+	double heapMs = MillisecondsSince(start) / frames;
+
+	FrameArena arena(1, 16 * 1024);
+	unsigned long long arenaSum = 0;
+	unsigned int warmOverflows = 0;
+	start = BenchClock::now();
+	for (int frame = 0; frame < frames; frame++) {
+		arena.BeginFrame();
+		for (unsigned int length : lengths) {
+			ArenaVector<unsigned int> list{ ArenaAllocator<unsigned int>(arena.ForThread(0)) };
+			list.reserve(length);
+			for (unsigned int i = 0; i < length; i++)
+				list.push_back(i * frame);
+			arenaSum += list[length / 2];
+		}
+		// both frames in flight have grown by now
+		if (frame == FrameArena::FRAMES_IN_FLIGHT - 1)
+			warmOverflows = arena.Overflows();
+	}
+	double arenaMs = MillisecondsSince(start) / frames;
+
+	std::cout << "FrameArena (" << listsPerFrame << " lists per frame)" << std::endl;
+	std::cout << "  per frame : heap " << heapMs << " ms, arena " << arenaMs << " ms";
+	if (heapSum != arenaSum || arena.Overflows() != warmOverflows)
+		std::cout << " MISMATCH: " << arena.Overflows() - warmOverflows << " overflows after warm-up";
+	std::cout << std::endl;
+}
+
+/// <summary>
+/// Runs a batch of jobs that each split their own work with a nested ParallelFor, the way asset imports parse
+/// their files, and a Bullet-style parallelSum; checks both against the same work on one thread and that a
+/// RunAfter job only starts once its dependency has drained.
+/// </summary>
+static void BenchmarkJobSystem() {
+	const unsigned int jobCount = 16;
+	const size_t itemsPerJob = 200000;
+	JobSystem jobs;
+
+	// a little arithmetic per item, so the work outweighs the scheduling
+	auto work = [](size_t item) {
+		unsigned int x = (unsigned int)item * 2654435761u;
+		for (int i = 0; i < 16; i++)
+			x = x * 1664525u + 1013904223u;
+		return (unsigned long long)(x >> 8);
+	};
+
+	std::vector<unsigned long long> serialSums(jobCount, 0);
+	BenchClock::time_point start = BenchClock::now();
+	for (unsigned int j = 0; j < jobCount; j++) {
+		for (size_t item = 0; item < itemsPerJob; item++)
+			serialSums[j] += work(j * itemsPerJob + item);
+	}
+	double serialMs = MillisecondsSince(start);
+
+	std::vector<std::atomic<unsigned long long>> sums(jobCount);
+	for (std::atomic<unsigned long long>& sum : sums)
+		sum = 0;
+	std::atomic<unsigned int> finishedBeforeFollowUp{ 0 };
+	JobCounter batch, followUp;
+	start = BenchClock::now();
+	for (unsigned int j = 0; j < jobCount; j++) {
+		jobs.Run([&, j]() {
+			jobs.ParallelFor(0, itemsPerJob, 4096, [&, j](size_t first, size_t last) {
+				unsigned long long sum = 0;
+				for (size_t item = first; item < last; item++)
+					sum += work(j * itemsPerJob + item);
+				sums[j] += sum;
+			});
+		}, &batch);
+	}
+	jobs.RunAfter(batch, [&]() {
+		for (unsigned int j = 0; j < jobCount; j++)
+			finishedBeforeFollowUp += sums[j] == serialSums[j];
+	}, &followUp);
+	jobs.Wait(batch);
+	double jobsMs = MillisecondsSince(start);
+	jobs.Wait(followUp);
+
+	struct SumBody : btIParallelSumBody {
+		btScalar sumLoop(int iBegin, int iEnd) const override {
+			btScalar sum = 0;
+			for (int i = iBegin; i < iEnd; i++)
+				sum += btScalar(i % 7);
+			return sum;
+		}
+	} sumBody;
+	btScalar parallelSum = jobs.parallelSum(0, 100000, 100, sumBody);
+	btScalar serialSum = sumBody.sumLoop(0, 100000);
+
+	std::cout << "JobSystem (" << jobs.ThreadCount() << " workers, " << jobCount << " jobs with nested parallel loops)" << std::endl;
+	std::cout << "  one thread " << serialMs << " ms, jobs " << jobsMs << " ms";
+	if (finishedBeforeFollowUp != jobCount || parallelSum != serialSum)
+		std::cout << " MISMATCH: " << jobCount - finishedBeforeFollowUp << " jobs unfinished or wrong when the follow-up ran, parallelSum "
+			<< parallelSum << " vs " << serialSum;
+	std::cout << std::endl;
+}
+
+void RunBenchmarks() {
+	BenchmarkIndexVBO();
+	BenchmarkRenderQueue();
+	BenchmarkFrustumCuller();
+	BenchmarkOcclusionBuffer();
+	BenchmarkLightGrid();
+	BenchmarkScene();
+	BenchmarkObjectPool();
+	BenchmarkFrameArena();
+	BenchmarkJobSystem();
+}
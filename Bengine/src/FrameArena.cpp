@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "headers/FrameArena.hpp"
+#include "headers/JobSystem.hpp"
+
+static inline size_t AlignUp(size_t value, size_t alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+LinearArena::LinearArena(size_t capacity) {
+	Reserve(capacity);
+}
+
+LinearArena::~LinearArena() {
+	Reset();
+	free(block);
+}
+
+void LinearArena::Reserve(size_t capacity) {
+	if (capacity <= this->capacity)
+		return;
+	free(block);
+	block = (unsigned char*)malloc(capacity);
+	this->capacity = capacity;
+	used = 0;
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment) {
+	// align the address rather than the offset, so the block itself needs no particular alignment
+	size_t offset = AlignUp((uintptr_t)block + used, alignment) - (uintptr_t)block;
+	if (block && offset + size <= capacity) {
+		used = offset + size;
+		return block + offset;
+	}
+
+	overflows++;
+	overflowBytes += size + alignment;
+	void* memory = malloc(size + alignment);
+	overflow.push_back(memory);
+	return (void*)AlignUp((uintptr_t)memory, alignment);
+}
+
+void LinearArena::Reset() {
+	if (!overflow.empty()) {
+		for (void* memory : overflow)
+			free(memory);
+		overflow.clear();
+		// room for everything the last run asked for, with slack so a slowly growing load doesn't overflow every frame
+		size_t needed = used + overflowBytes;
+		Reserve(needed + needed / 2);
+		overflowBytes = 0;
+	}
+	used = 0;
+}
+
+FrameArena::FrameArena(unsigned int threadCount, size_t bytesPerThread)
+	: arenas(threadCount * FRAMES_IN_FLIGHT), threadCount(threadCount) {
+	for (LinearArena& arena : arenas)
+		arena.Reserve(bytesPerThread);
+}
+
+void FrameArena::BeginFrame() {
+	frame = (frame + 1) % FRAMES_IN_FLIGHT;
+	for (unsigned int thread = 0; thread < threadCount; thread++)
+		ForThread(thread).Reset();
+}
+
+LinearArena& FrameArena::Local() {
+	return ForThread(JobSystem::ThreadIndex());
+}
+
+unsigned int FrameArena::Overflows() const {
+	unsigned int total = 0;
+	for (const LinearArena& arena : arenas)
+		total += arena.Overflows();
+	return total;
+}
@@ -0,0 +1,186 @@
+#include <xmmintrin.h>
+
+#include "headers/FrustumCuller.hpp"
+
+Frustum Frustum::FromMatrix(const glm::mat4& viewProj) {
+	// Gribb and Hartmann: each plane is the fourth row plus or minus one of the others
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++)
+		rows[r] = glm::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r], viewProj[3][r]);
+
+	const glm::vec4 planes[6] = {
+		rows[3] + rows[0], rows[3] - rows[0], // left, right
+		rows[3] + rows[1], rows[3] - rows[1], // bottom, top
+		rows[3] + rows[2], rows[3] - rows[2], // near, far
+	};
+
+	Frustum frustum;
+	for (int i = 0; i < 6; i++) {
+		float length = glm::length(glm::vec3(planes[i]));
+		frustum.normals[i] = glm::vec3(planes[i]) / length;
+		frustum.offsets[i] = planes[i].w / length;
+	}
+	return frustum;
+}
+
+void transformBounds(const glm::mat4& model, const glm::vec3& localMin, const glm::vec3& localMax, glm::vec3& out_min, glm::vec3& out_max) {
+	// Arvo: the extent along each world axis is the local extent through the absolute rotation
+	glm::vec3 center = glm::vec3(model * glm::vec4((localMin + localMax) * 0.5f, 1.0f));
+	glm::vec3 extent = (localMax - localMin) * 0.5f;
+	glm::mat3 absolute = glm::mat3(model);
+	for (int c = 0; c < 3; c++)
+		absolute[c] = glm::abs(absolute[c]);
+	glm::vec3 worldExtent = absolute * extent;
+	out_min = center - worldExtent;
+	out_max = center + worldExtent;
+}
+
+static btDbvtVolume toVolume(const glm::vec3& min, const glm::vec3& max) {
+	return btDbvtVolume::FromMM(btVector3(min.x, min.y, min.z), btVector3(max.x, max.y, max.z));
+}
+
+void FrustumCuller::SetStatic(unsigned int object, const glm::vec3& min, const glm::vec3& max) {
+	if (object >= slots.size())
+		slots.resize(object + 1);
+	ObjectSlot& slot = slots[object];
+
+	if (slot.kind == Kind::Static) {
+		btDbvtVolume volume = toVolume(min, max);
+		staticTree.update(slot.leaf, volume);
+		return;
+	}
+	if (slot.kind == Kind::Dynamic) {
+		SetDynamic(object, min, max);
+		return;
+	}
+
+	slot.kind = Kind::Static;
+	staticCount++;
+	slot.leaf = staticTree.insert(toVolume(min, max), (void*)(size_t)object);
+}
+
+void FrustumCuller::SetDynamic(unsigned int object, const glm::vec3& min, const glm::vec3& max) {
+	if (object >= slots.size())
+		slots.resize(object + 1);
+	ObjectSlot& slot = slots[object];
+
+	if (slot.kind == Kind::Static) {
+		SetStatic(object, min, max);
+		return;
+	}
+	if (slot.kind == Kind::None) {
+		slot.kind = Kind::Dynamic;
+		slot.dynamicIndex = (unsigned int)dynamicObjects.size();
+		dynamicObjects.push_back(object);
+
+		// grow in blocks of four; padding lanes get an empty box far outside any frustum
+		size_t padded = (dynamicObjects.size() + 3) & ~(size_t)3;
+		centerX.resize(padded, 1e30f);
+		centerY.resize(padded, 1e30f);
+		centerZ.resize(padded, 1e30f);
+		extentX.resize(padded, 0.0f);
+		extentY.resize(padded, 0.0f);
+		extentZ.resize(padded, 0.0f);
+	}
+
+	unsigned int i = slot.dynamicIndex;
+	centerX[i] = (min.x + max.x) * 0.5f;
+	centerY[i] = (min.y + max.y) * 0.5f;
+	centerZ[i] = (min.z + max.z) * 0.5f;
+	extentX[i] = (max.x - min.x) * 0.5f;
+	extentY[i] = (max.y - min.y) * 0.5f;
+	extentZ[i] = (max.z - min.z) * 0.5f;
+}
+
+void FrustumCuller::Remove(unsigned int object) {
+	if (!Contains(object))
+		return;
+	ObjectSlot& slot = slots[object];
+
+	if (slot.kind == Kind::Static) {
+		staticTree.remove(slot.leaf);
+		staticCount--;
+	}
+	else {
+		// move the last dynamic object into the hole; lanes past the count are never reported
+		unsigned int i = slot.dynamicIndex;
+		unsigned int last = (unsigned int)dynamicObjects.size() - 1;
+		unsigned int moved = dynamicObjects[last];
+		centerX[i] = centerX[last];
+		centerY[i] = centerY[last];
+		centerZ[i] = centerZ[last];
+		extentX[i] = extentX[last];
+		extentY[i] = extentY[last];
+		extentZ[i] = extentZ[last];
+		dynamicObjects[i] = moved;
+		slots[moved].dynamicIndex = i;
+		dynamicObjects.pop_back();
+	}
+	slot = ObjectSlot();
+}
+
+bool FrustumCuller::Contains(unsigned int object) const {
+	return object < slots.size() && slots[object].kind != Kind::None;
+}
+
+namespace {
+	struct CollectVisible : btDbvt::ICollide {
+		std::vector<unsigned int>* visible;
+		void Process(const btDbvtNode* leaf) override {
+			visible->push_back((unsigned int)(size_t)leaf->data);
+		}
+	};
+}
+
+void FrustumCuller::Cull(const Frustum& frustum, std::vector<unsigned int>& out_visible, CullStats* out_stats) const {
+	size_t firstVisible = out_visible.size();
+
+	// static: walk the tree, skipping whole subtrees outside a plane and stopping plane tests once inside all of them
+	btVector3 normals[6];
+	btScalar offsets[6];
+	for (int i = 0; i < 6; i++) {
+		normals[i] = btVector3(frustum.normals[i].x, frustum.normals[i].y, frustum.normals[i].z);
+		offsets[i] = frustum.offsets[i];
+	}
+	CollectVisible collect;
+	collect.visible = &out_visible;
+	btDbvt::collideKDOP(staticTree.m_root, normals, offsets, 6, collect);
+	size_t staticVisible = out_visible.size() - firstVisible;
+
+	// dynamic: a box is outside a plane when its center is further behind it than its projected radius
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6], planeAbsX[6], planeAbsY[6], planeAbsZ[6];
+	for (int p = 0; p < 6; p++) {
+		planeX[p] = _mm_set1_ps(frustum.normals[p].x);
+		planeY[p] = _mm_set1_ps(frustum.normals[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.normals[p].z);
+		planeW[p] = _mm_set1_ps(frustum.offsets[p]);
+		planeAbsX[p] = _mm_set1_ps(fabsf(frustum.normals[p].x));
+		planeAbsY[p] = _mm_set1_ps(fabsf(frustum.normals[p].y));
+		planeAbsZ[p] = _mm_set1_ps(fabsf(frustum.normals[p].z));
+	}
+	const __m128 zero = _mm_setzero_ps();
+	for (size_t i = 0; i < dynamicObjects.size(); i += 4) {
+		__m128 cx = _mm_loadu_ps(&centerX[i]), cy = _mm_loadu_ps(&centerY[i]), cz = _mm_loadu_ps(&centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&extentX[i]), ey = _mm_loadu_ps(&extentY[i]), ez = _mm_loadu_ps(&extentZ[i]);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)), _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeAbsX[p], ex), _mm_mul_ps(planeAbsY[p], ey)), _mm_mul_ps(planeAbsZ[p], ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		int outsideMask = _mm_movemask_ps(outside);
+		for (size_t lane = 0; lane < 4 && i + lane < dynamicObjects.size(); lane++) {
+			if (!(outsideMask & (1 << lane)))
+				out_visible.push_back(dynamicObjects[i + lane]);
+		}
+	}
+
+	if (out_stats) {
+		out_stats->staticObjects = staticCount;
+		out_stats->staticVisible = (unsigned int)staticVisible;
+		out_stats->dynamicObjects = (unsigned int)dynamicObjects.size();
+		out_stats->dynamicVisible = (unsigned int)(out_visible.size() - firstVisible - staticVisible);
+	}
+}
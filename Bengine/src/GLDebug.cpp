@@ -0,0 +1,121 @@
+#include <iostream>
+
+#include "headers/GLDebug.hpp"
+
+bool glDebugOutputInstalled = false;
+
+void GLClearError() {
+
+	while (glGetError());
+}
+
+bool GLLogCall(const char* function, const char* file, int line) {
+
+	while (GLenum error = glGetError()) {
+
+		std::cout << "[OPENGL ERROR " << error << "] : " << file
+			<< " LINE " << line << " : " << function << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static const char* DebugSourceName(GLenum source) {
+	switch (source) {
+	case GL_DEBUG_SOURCE_API: return "API";
+	case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "WINDOW SYSTEM";
+	case GL_DEBUG_SOURCE_SHADER_COMPILER: return "SHADER COMPILER";
+	case GL_DEBUG_SOURCE_THIRD_PARTY: return "THIRD PARTY";
+	case GL_DEBUG_SOURCE_APPLICATION: return "APPLICATION";
+	default: return "OTHER";
+	}
+}
+
+static const char* DebugTypeName(GLenum type) {
+	switch (type) {
+	case GL_DEBUG_TYPE_ERROR: return "ERROR";
+	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "DEPRECATED";
+	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "UNDEFINED BEHAVIOR";
+	case GL_DEBUG_TYPE_PORTABILITY: return "PORTABILITY";
+	case GL_DEBUG_TYPE_PERFORMANCE: return "PERFORMANCE";
+	default: return "OTHER";
+	}
+}
+
+static void GLAPIENTRY DebugOutput(GLenum source, GLenum type, GLuint id, GLenum /*severity*/, GLsizei /*length*/, const GLchar* message, const void* /*userParam*/) {
+	std::cout << "[OPENGL " << DebugTypeName(type) << " " << id << "] " << DebugSourceName(source) << " : " << message << std::endl;
+#ifdef GL_DIAGNOSTICS_SYNCHRONOUS
+	ASSERT(type != GL_DEBUG_TYPE_ERROR)
+#endif
+}
+
+bool GLInstallDebugOutput() {
+#if GL_DIAGNOSTICS
+	if (!GLEW_KHR_debug && !GLEW_VERSION_4_3)
+		return false;
+
+	glEnable(GL_DEBUG_OUTPUT);
+#ifdef GL_DIAGNOSTICS_SYNCHRONOUS
+	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#endif
+	glDebugMessageCallback(DebugOutput, nullptr);
+	// buffer usage hints and the like arrive at notification severity every frame
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+	glDebugOutputInstalled = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+unsigned int GpuTimer::AddPass(const char* name) {
+	Pass pass;
+	pass.name = name;
+	glGenQueries(2, pass.queries);
+	passes.push_back(pass);
+	return (unsigned int)passes.size() - 1;
+}
+
+void GpuTimer::Begin(unsigned int pass) {
+	Pass& p = passes[pass];
+
+	// issued two frames ago; skip the read rather than stall if the GPU is that far behind
+	if (p.issued[frame]) {
+		GLint available = 0;
+		glGetQueryObjectiv(p.queries[frame], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(p.queries[frame], GL_QUERY_RESULT, &nanoseconds);
+			p.milliseconds = nanoseconds / 1000000.0;
+		}
+	}
+
+#if GL_DIAGNOSTICS
+	if (glDebugOutputInstalled)
+		glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, pass, -1, p.name);
+#endif
+	glBeginQuery(GL_TIME_ELAPSED, p.queries[frame]);
+	p.issued[frame] = true;
+	activePass = (int)pass;
+}
+
+void GpuTimer::End() {
+	if (activePass < 0)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+#if GL_DIAGNOSTICS
+	if (glDebugOutputInstalled)
+		glPopDebugGroup();
+#endif
+	activePass = -1;
+}
+
+void GpuTimer::EndFrame() {
+	frame ^= 1;
+}
+
+void GpuTimer::Destroy() {
+	for (Pass& pass : passes)
+		glDeleteQueries(2, pass.queries);
+	passes.clear();
+}
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <string.h>
+#include <glew.h>
+
+#include "headers/GpuMeshPool.hpp"
+#include "headers/GLDebug.hpp"
+
+GpuMeshRange GpuMeshPool::Reserve(const ImportedMesh& mesh, unsigned int stride) {
+	if (vertexStride == 0)
+		vertexStride = stride;
+	if (stride != vertexStride)
+		std::cout << "GpuMeshPool: mesh stride " << stride << " doesn't match the pool's " << vertexStride << std::endl;
+
+	// index ranges of different widths share the buffer, so align each to its own width
+	size_t indexSize = mesh.ebo.indexSize();
+	indexBytes = (indexBytes + indexSize - 1) / indexSize * indexSize;
+
+	Entry entry;
+	entry.mesh = &mesh;
+	entry.vertexOffset = vertexBytes;
+	entry.indexOffset = indexBytes;
+	entries.push_back(entry);
+
+	vertexBytes += mesh.gpuVertices.size();
+	indexBytes += mesh.ebo.byteSize();
+
+	GpuMeshRange range;
+	range.baseVertex = (int)(entry.vertexOffset / vertexStride);
+	range.indexOffset = entry.indexOffset;
+	return range;
+}
+
+void GpuMeshPool::Upload() {
+	if (!vertexBuffer)
+		GLCALL(glGenBuffers(1, &vertexBuffer));
+	if (!indexBuffer)
+		GLCALL(glGenBuffers(1, &indexBuffer));
+
+	// allocate once, then fill in place; nothing is rewritten after load
+	GLCALL(glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer));
+	GLCALL(glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW));
+	GLCALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer));
+	GLCALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW));
+
+	for (const Entry& entry : entries) {
+		const ImportedMesh& mesh = *entry.mesh;
+		if (!mesh.gpuVertices.empty())
+			GLCALL(glBufferSubData(GL_ARRAY_BUFFER, entry.vertexOffset, mesh.gpuVertices.size(), &mesh.gpuVertices[0]));
+		if (mesh.ebo.byteSize() > 0)
+			GLCALL(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, entry.indexOffset, mesh.ebo.byteSize(), mesh.ebo.data()));
+	}
+}
+
+bool GpuMeshPool::Validate() const {
+	std::vector<unsigned char> vertices(vertexBytes);
+	std::vector<unsigned char> indices(indexBytes);
+	GLCALL(glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer));
+	if (vertexBytes)
+		GLCALL(glGetBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, &vertices[0]));
+	GLCALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer));
+	if (indexBytes)
+		GLCALL(glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexBytes, &indices[0]));
+
+	for (size_t i = 0; i < entries.size(); i++) {
+		const ImportedMesh& mesh = *entries[i].mesh;
+		if (!mesh.gpuVertices.empty() && memcmp(&vertices[entries[i].vertexOffset], &mesh.gpuVertices[0], mesh.gpuVertices.size()) != 0) {
+			std::cout << "GpuMeshPool: vertices of mesh " << i << " don't match after upload" << std::endl;
+			return false;
+		}
+		if (mesh.ebo.byteSize() > 0 && memcmp(&indices[entries[i].indexOffset], mesh.ebo.data(), mesh.ebo.byteSize()) != 0) {
+			std::cout << "GpuMeshPool: indices of mesh " << i << " don't match after upload" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+void GpuMeshPool::Destroy() {
+	if (vertexBuffer)
+		GLCALL(glDeleteBuffers(1, &vertexBuffer));
+	if (indexBuffer)
+		GLCALL(glDeleteBuffers(1, &indexBuffer));
+	vertexBuffer = indexBuffer = 0;
+}
+
+void releaseCpuGeometry(ImportedMesh& mesh, bool keepCollisionData) {
+	std::vector<unsigned char>().swap(mesh.gpuVertices);
+	if (keepCollisionData)
+		return;
+	std::vector<float>().swap(mesh.vbo);
+	std::vector<unsigned short>().swap(mesh.ebo.indices16);
+	std::vector<unsigned int>().swap(mesh.ebo.indices32);
+}
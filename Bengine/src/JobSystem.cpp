@@ -0,0 +1,251 @@
+#include <algorithm>
+
+#include "headers/JobSystem.hpp"
+
+// Bullet hands out its thread indices first come, first served and sizes per-thread tables by getNumThreads.
+// Besides the workers, two threads outside the pool reach it: the one that installs the scheduler, and the
+// simulation thread, which takes ranges of the loops it starts.
+static const int OUTSIDE_BULLET_THREADS = 2;
+
+static thread_local const JobSystem* workerOwner = nullptr;
+static thread_local unsigned int workerIndex = 0;
+
+void JobSystem::Queue::PushBack(Job&& job) {
+	if (count == ring.size()) {
+		// unroll the ring into twice the room, front first
+		std::vector<Job> grown(std::max<size_t>(ring.size() * 2, 16));
+		for (size_t i = 0; i < count; i++)
+			grown[i] = std::move(ring[(head + i) & (ring.size() - 1)]);
+		ring.swap(grown);
+		head = 0;
+	}
+	ring[(head + count) & (ring.size() - 1)] = std::move(job);
+	count++;
+}
+
+bool JobSystem::Queue::PopBack(Job& out_job) {
+	if (count == 0)
+		return false;
+	count--;
+	out_job = std::move(ring[(head + count) & (ring.size() - 1)]);
+	return true;
+}
+
+bool JobSystem::Queue::PopFront(Job& out_job) {
+	if (count == 0)
+		return false;
+	out_job = std::move(ring[head]);
+	head = (head + 1) & (ring.size() - 1);
+	count--;
+	return true;
+}
+
+JobSystem::JobSystem(unsigned int workerCount) : btITaskScheduler("Bengine") {
+	if (workerCount == 0)
+		workerCount = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1;
+	workerCount = std::min(workerCount, (unsigned int)(BT_MAX_THREAD_COUNT - OUTSIDE_BULLET_THREADS));
+
+	for (unsigned int i = 0; i <= workerCount; i++)
+		queues.emplace_back(new Queue());
+	for (unsigned int i = 0; i < workerCount; i++)
+		threads.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+}
+
+JobSystem::~JobSystem() {
+	stopping = true;
+	{
+		// a worker between checking for work and going to sleep holds this, so it can't miss the wakeup
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	jobAvailable.notify_all();
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+unsigned int JobSystem::ThreadIndex() {
+	return workerIndex;
+}
+
+void JobSystem::Run(std::function<void()> task, JobCounter* counter) {
+	if (counter)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	Job job;
+	job.task = std::move(task);
+	job.counter = counter;
+	Push(std::move(job));
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, std::function<void()> task, JobCounter* counter) {
+	if (counter)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	{
+		// the last job to report takes the lock to drain the continuations, so this can't slip in between
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (dependency.pending.load(std::memory_order_acquire) > 0) {
+			JobCounter::Continuation continuation;
+			continuation.task = std::move(task);
+			continuation.counter = counter;
+			dependency.continuations.push_back(std::move(continuation));
+			return;
+		}
+	}
+	Job job;
+	job.task = std::move(task);
+	job.counter = counter;
+	Push(std::move(job));
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+	if (workerOwner == this) {
+		while (!counter.Done()) {
+			if (!TryRunOne())
+				std::this_thread::yield();
+		}
+	}
+	std::unique_lock<std::mutex> lock(counter.mutex);
+	counter.drained.wait(lock, [&counter]() { return counter.pending.load(std::memory_order_acquire) == 0; });
+}
+
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grainSize, RangeFunction range, const void* context) {
+	if (end <= begin)
+		return;
+	grainSize = std::max<size_t>(grainSize, 1);
+	size_t rangeCount = (end - begin + grainSize - 1) / grainSize;
+
+	RangeBatch batch;
+	batch.range = range;
+	batch.context = context;
+	batch.end = end;
+	batch.grainSize = grainSize;
+	batch.next.store(begin, std::memory_order_relaxed);
+
+	// one helper per worker at most; each keeps taking ranges, so a late one finds nothing left and returns
+	JobCounter counter;
+	size_t helpers = std::min(rangeCount - 1, threads.size());
+	for (size_t i = 0; i < helpers; i++) {
+		counter.pending.fetch_add(1, std::memory_order_relaxed);
+		Job job;
+		job.batch = &batch;
+		job.counter = &counter;
+		Push(std::move(job));
+	}
+	RunRanges(batch);
+	Wait(counter);
+}
+
+void JobSystem::RunRanges(RangeBatch& batch) {
+	while (true) {
+		size_t first = batch.next.fetch_add(batch.grainSize, std::memory_order_relaxed);
+		if (first >= batch.end)
+			return;
+		batch.range(batch.context, first, std::min(first + batch.grainSize, batch.end));
+	}
+}
+
+void JobSystem::Push(Job&& job) {
+	Queue& queue = *queues[workerOwner == this ? workerIndex - 1 : threads.size()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.PushBack(std::move(job));
+		queuedJobs.fetch_add(1);
+	}
+	// pairs with the sleeping count a worker raises before its last look at queuedJobs: one of them sees the other
+	if (sleepingWorkers.load() > 0) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		jobAvailable.notify_one();
+	}
+}
+
+bool JobSystem::TryRunOne() {
+	const size_t own = workerIndex - 1;
+	Job job;
+	bool found = false;
+	{
+		std::lock_guard<std::mutex> lock(queues[own]->mutex);
+		found = queues[own]->PopBack(job);
+	}
+	for (size_t i = 1; i < queues.size() && !found; i++) {
+		Queue& victim = *queues[(own + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		found = victim.PopFront(job);
+	}
+	if (!found)
+		return false;
+
+	queuedJobs.fetch_sub(1);
+	Execute(job);
+	return true;
+}
+
+void JobSystem::Execute(Job& job) {
+	if (job.batch)
+		RunRanges(*job.batch);
+	else
+		job.task();
+	Finish(job.counter);
+}
+
+void JobSystem::Finish(JobCounter* counter) {
+	if (!counter)
+		return;
+	std::vector<JobCounter::Continuation> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+		ready.swap(counter->continuations);
+		counter->drained.notify_all();
+	}
+	// the continuations were counted when they were queued
+	for (JobCounter::Continuation& continuation : ready) {
+		Job job;
+		job.task = std::move(continuation.task);
+		job.counter = continuation.counter;
+		Push(std::move(job));
+	}
+}
+
+void JobSystem::WorkerLoop(unsigned int index) {
+	workerOwner = this;
+	workerIndex = index;
+	while (!stopping) {
+		if (TryRunOne())
+			continue;
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingWorkers.fetch_add(1);
+		jobAvailable.wait(lock, [this]() { return stopping || queuedJobs.load() > 0; });
+		sleepingWorkers.fetch_sub(1);
+	}
+}
+
+int JobSystem::getMaxNumThreads() const {
+	return BT_MAX_THREAD_COUNT;
+}
+
+int JobSystem::getNumThreads() const {
+	return (int)threads.size() + OUTSIDE_BULLET_THREADS;
+}
+
+void JobSystem::parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body) {
+	ParallelFor(iBegin, iEnd, grainSize, [&body](size_t first, size_t last) {
+		body.forLoop((int)first, (int)last);
+	});
+}
+
+btScalar JobSystem::parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body) {
+	// a sum per range, added up in order afterwards so the result doesn't depend on scheduling
+	const int MAX_RANGES = 64;
+	if (iEnd <= iBegin)
+		return btScalar(0);
+	grainSize = std::max(grainSize, 1);
+	grainSize = std::max(grainSize, (iEnd - iBegin + MAX_RANGES - 1) / MAX_RANGES);
+	btScalar sums[MAX_RANGES];
+	ParallelFor(iBegin, iEnd, grainSize, [&](size_t first, size_t last) {
+		sums[(first - iBegin) / grainSize] = body.sumLoop((int)first, (int)last);
+	});
+
+	btScalar sum = btScalar(0);
+	for (int i = 0; i < (iEnd - iBegin + grainSize - 1) / grainSize; i++)
+		sum += sums[i];
+	return sum;
+}
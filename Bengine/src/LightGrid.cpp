@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cmath>
+#include <xmmintrin.h>
+
+#include "headers/LightGrid.hpp"
+
+void LightGrid::SetProjection(float fovY, float aspect, float nearPlane, float farPlane) {
+	if (fovY == this->fovY && aspect == this->aspect && nearPlane == this->nearPlane && farPlane == this->farPlane)
+		return;
+	this->fovY = fovY;
+	this->aspect = aspect;
+	this->nearPlane = nearPlane;
+	this->farPlane = farPlane;
+
+	sliceScale = SLICES / logf(farPlane / nearPlane);
+	sliceBias = -(float)SLICES * logf(nearPlane) / logf(farPlane / nearPlane);
+
+	const float tanY = tanf(fovY * 0.5f);
+	const float tanX = tanY * aspect;
+	for (std::vector<float>* bounds : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+		bounds->resize(CLUSTER_COUNT);
+
+	for (unsigned int slice = 0; slice < SLICES; slice++) {
+		// the camera looks down -z, so depth d is at z = -d
+		float sliceNear = nearPlane * powf(farPlane / nearPlane, (float)slice / SLICES);
+		float sliceFar = nearPlane * powf(farPlane / nearPlane, (float)(slice + 1) / SLICES);
+		for (unsigned int y = 0; y < TILES_Y; y++) {
+			float y0 = (2.0f * y / TILES_Y - 1.0f) * tanY, y1 = (2.0f * (y + 1) / TILES_Y - 1.0f) * tanY;
+			for (unsigned int x = 0; x < TILES_X; x++) {
+				float x0 = (2.0f * x / TILES_X - 1.0f) * tanX, x1 = (2.0f * (x + 1) / TILES_X - 1.0f) * tanX;
+				unsigned int cluster = (slice * TILES_Y + y) * TILES_X + x;
+				// the tile's side planes spread out with depth, so the box spans both ends
+				minX[cluster] = std::min(x0 * sliceNear, x0 * sliceFar);
+				maxX[cluster] = std::max(x1 * sliceNear, x1 * sliceFar);
+				minY[cluster] = std::min(y0 * sliceNear, y0 * sliceFar);
+				maxY[cluster] = std::max(y1 * sliceNear, y1 * sliceFar);
+				minZ[cluster] = -sliceFar;
+				maxZ[cluster] = -sliceNear;
+			}
+		}
+	}
+}
+
+void LightGrid::Build(const std::vector<PointLight>& lights, const glm::mat4& view, LinearArena& scratch) {
+	hitClusters.clear();
+	hitLights.clear();
+
+	const __m128 zero = _mm_setzero_ps();
+	for (size_t l = 0; l < lights.size() && l <= 0xFFFF; l++) {
+		const PointLight& light = lights[l];
+		glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+		float depthNear = -center.z - light.radius, depthFar = -center.z + light.radius;
+		if (depthFar < nearPlane || depthNear > farPlane)
+			continue;
+
+		// one slice of slack each way; the log here and the pow that placed the slices can round apart
+		int firstSlice = depthNear <= nearPlane ? 0 : (int)floorf(logf(depthNear) * sliceScale + sliceBias) - 1;
+		int lastSlice = (int)floorf(logf(std::min(depthFar, farPlane)) * sliceScale + sliceBias) + 1;
+		firstSlice = std::max(firstSlice, 0);
+		lastSlice = std::min(lastSlice, (int)SLICES - 1);
+
+		const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+		const __m128 radiusSquared = _mm_set1_ps(light.radius * light.radius);
+		for (int slice = firstSlice; slice <= lastSlice; slice++) {
+			for (unsigned int i = slice * TILES_X * TILES_Y; i < (slice + 1) * TILES_X * TILES_Y; i += 4) {
+				// distance from the center to the box, per axis: how far it is past either face
+				__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[i]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&maxX[i]))), zero);
+				__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[i]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&maxY[i]))), zero);
+				__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[i]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&maxZ[i]))), zero);
+				__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, radiusSquared));
+				for (int lane = 0; mask; lane++, mask >>= 1) {
+					if (mask & 1) {
+						hitClusters.push_back(i + lane);
+						hitLights.push_back((unsigned short)l);
+					}
+				}
+			}
+		}
+	}
+
+	// counting sort by cluster; lights stay in order within each cluster
+	clusters.assign(CLUSTER_COUNT * 2, 0);
+	for (unsigned int cluster : hitClusters)
+		clusters[cluster * 2 + 1]++;
+	unsigned int offset = 0;
+	for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+		clusters[cluster * 2] = offset;
+		offset += clusters[cluster * 2 + 1];
+	}
+	lightIndices.resize(hitLights.size());
+	unsigned int* cursor = scratch.Allocate<unsigned int>(CLUSTER_COUNT);
+	for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+		cursor[cluster] = clusters[cluster * 2];
+	for (size_t h = 0; h < hitClusters.size(); h++)
+		lightIndices[cursor[hitClusters[h]]++] = hitLights[h];
+}
+
+void LightGridTextures::Create() {
+	const GLenum formats[3] = { GL_RG32UI, GL_R16UI, GL_RGBA32F };
+	glGenBuffers(3, buffers);
+	glGenTextures(3, textures);
+	for (int i = 0; i < 3; i++) {
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightGridTextures::Upload(const LightGrid& grid, const std::vector<PointLight>& lights) {
+	lightTexels.resize(lights.size() * 2);
+	for (size_t l = 0; l < lights.size(); l++) {
+		lightTexels[l * 2] = glm::vec4(lights[l].position, lights[l].radius);
+		lightTexels[l * 2 + 1] = glm::vec4(lights[l].color * lights[l].intensity, 0.0f);
+	}
+
+	const void* data[3] = { &grid.Clusters()[0], grid.LightIndices().empty() ? nullptr : &grid.LightIndices()[0],
+		lightTexels.empty() ? nullptr : &lightTexels[0] };
+	const size_t sizes[3] = { grid.Clusters().size() * sizeof(unsigned int), grid.LightIndices().size() * sizeof(unsigned short),
+		lightTexels.size() * sizeof(glm::vec4) };
+	for (int i = 0; i < 3; i++) {
+		// an empty texture buffer is still a valid binding, but keep one texel so the store is never zero sized
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(sizes[i], 16), nullptr, GL_STREAM_DRAW);
+		if (sizes[i] > 0)
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightGridTextures::Bind(GLuint firstUnit) const {
+	for (int i = 0; i < 3; i++) {
+		glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void LightGridTextures::Destroy() {
+	glDeleteTextures(3, textures);
+	glDeleteBuffers(3, buffers);
+	for (int i = 0; i < 3; i++)
+		textures[i] = buffers[i] = 0;
+}
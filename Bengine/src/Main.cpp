@@ -1,83 +1,5 @@
 #include "headers/Main.hpp"
 
-constexpr auto VERTEX_SIZE = 10;
-
-static void GLClearError() {
-
-	while (glGetError());
-}
-
-static bool GLLogCall(const char* function, const char* file, int line) {
-
-	while (GLenum error = glGetError()) {
-
-		std::cout << "[OPENGL ERROR " << error << "] : " << file
-			<< " LINE " << line << " : " << function << std::endl;
-		return false;
-	}
-	return true;
-}
-
-static std::string ParseShader(const std::string& filepath) {
-
-	std::ifstream stream(filepath);
-
-	std::string line;
-	std::stringstream ss;
-
-	while (getline(stream, line)) {
-
-		ss << line << '\n';
-	}
-	return ss.str();
-}
-
-static unsigned int CompileShader(unsigned int type, const std::string& source) {
-
-	unsigned int id = glCreateShader(type);
-	const char* src = source.c_str();
-	GLCALL(glShaderSource(id, 1, &src, nullptr));
-	GLCALL(glCompileShader(id));
-
-	//Error checker, returns false if contains syntax errors
-	int result;
-	GLCALL(glGetShaderiv(id, GL_COMPILE_STATUS, &result));
-	if (result == GL_FALSE) {
-
-		int length;
-		GLCALL(glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length));
-		char* message = (char*)_malloca(length * sizeof(char));
-		GLCALL(glGetShaderInfoLog(id, length, &length, message));
-		std::cout << "Failed to compile shader of type " << type << std::endl;
-		std::cout << message << std::endl;
-
-		GLCALL(glDeleteShader(id));
-		return 0;
-	}
-	else {
-		
-		std::cout << "Shader of type " << type << " compiled successfully." << std::endl;
-	}
-
-	return id;
-}
-
-static unsigned int CreateShaderProgram(const std::string& vertexShader, const std::string& fragmentShader) {
-
-	unsigned int program = glCreateProgram();
-	unsigned int vs = CompileShader(GL_VERTEX_SHADER, vertexShader);
-	unsigned int fs = CompileShader(GL_FRAGMENT_SHADER, fragmentShader);
-
-	GLCALL(glAttachShader(program, vs));
-	GLCALL(glAttachShader(program, fs));
-	GLCALL(glLinkProgram(program));
-	GLCALL(glValidateProgram(program));
-
-	GLCALL(glDeleteShader(vs));
-	GLCALL(glDeleteShader(fs));
-
-	return program;
-}
 /// <summary>
 /// Converts glm::vec3 to btVector3.
 /// </summary>
@@ -95,7 +17,9 @@ static glm::vec3 BtToVec3(const btVector3 v) {
 	return glm::vec3(v.getX(), v.getY(), v.getZ());
 }
 
-static void CreateObject(btVector3 origin, btScalar mass,
+// Gives the entity its transform and a body in the world; mass 0 makes it static.
+// Only whoever owns the world may call this: the main thread before the simulation starts or after it stops.
+static btRigidBody* CreateObject(Scene& scene, PhysicsPools& pools, Entity entity, btVector3 origin, btScalar mass,
 	btCollisionShape* shape, btAlignedObjectArray<btCollisionShape*>& collisionShapes,
 	btDiscreteDynamicsWorld* world) {
 	
@@ -105,112 +29,177 @@ static void CreateObject(btVector3 origin, btScalar mass,
 	transform.setIdentity();
 	transform.setOrigin(origin);
 
-	//rigidbody is dynamic if and only if mass is non zero, otherwise static
-	bool isDynamic = (mass != 0.f);
-
-	btVector3 localInertia(0, 0, 0);
-	if (isDynamic)
-		shape->calculateLocalInertia(mass, localInertia);
-
-	//using motionstate is optional, it provides interpolation capabilities, and only synchronizes 'active' objects
-	btDefaultMotionState* myMotionState = new btDefaultMotionState(transform);
-	btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, myMotionState, shape, localInertia);
-	btRigidBody* body = new btRigidBody(rbInfo);
-
-	//add the body to the dynamics world
-	world->addRigidBody(body);
+	scene.transforms.Add(entity, transform);
+	RenderMesh* mesh = scene.renderMeshes.Find(entity);
+	if (mesh)
+		mesh->isStatic = mass == 0.f;
+	return createPhysicsBody(pools, entity, transform, mass, shape, world);
 }
 
-static Mesh* CreateMesh(const char* name, int meshIndex, glm::vec4 color, std::vector<Mesh*>& meshes) {
-	Mesh* newMesh = new Mesh();
-	newMesh->name = name;
-	newMesh->meshIndex = meshIndex;
-	newMesh->bufferIndex = meshes.size();
-	newMesh->color = color;
-	return newMesh;
+static Entity CreateRenderEntity(Scene& scene, const char* name, int meshIndex, glm::vec4 color) {
+	Entity entity = scene.Create(name);
+	scene.transforms.Add(entity, btTransform::getIdentity());
+	RenderMesh mesh;
+	mesh.meshIndex = meshIndex;
+	scene.renderMeshes.Add(entity, mesh);
+	Material material;
+	material.color = color;
+	scene.materials.Add(entity, material);
+	return entity;
 }
 
-static Mesh* CreateMesh() {
-	Mesh* newMesh = new Mesh();
-	newMesh->empty = true;
-	return newMesh;
-}
+// Wraps the asset's own vertices and indices for Bullet instead of copying them into a btTriangleMesh,
+// so the asset must outlive the shape. Positions are the first three floats of each VERTEX_SIZE vertex.
+static btTriangleIndexVertexArray* GenerateTriangleCollisionMesh(const MeshAsset& source) {
+	btTriangleIndexVertexArray* triMesh = new btTriangleIndexVertexArray();
+	const IndexBuffer& ebo = source.ebo;
+	const int vertexCount = (int)(source.vbo.size() / VERTEX_SIZE);
+
+	// unsplit meshes are one chunk covering full detail; the LODs after it are for drawing only
+	std::vector<IndexChunk> chunks = ebo.chunks;
+	if (chunks.empty()) {
+		IndexChunk whole;
+		whole.indexCount = source.lods[0].indexCount;
+		chunks.push_back(whole);
+	}
 
-static btTriangleMesh* GenerateTriangleCollisionMesh(std::vector<std::vector<unsigned short>> EBOs, std::vector<std::vector<float>> VBOs, Mesh source) {
-	// wtf? this was a massive headache
-	btTriangleMesh* triMesh = new btTriangleMesh();
-	for (int i = 0; i < EBOs[source.bufferIndex].size();) {
-		int bufferIndex = source.bufferIndex;
-		btVector3 v1 = btVector3(
-			VBOs[bufferIndex][EBOs[bufferIndex][i] * VERTEX_SIZE],
-			VBOs[bufferIndex][EBOs[bufferIndex][i] * VERTEX_SIZE + 1],
-			VBOs[bufferIndex][EBOs[bufferIndex][i] * VERTEX_SIZE + 2]);
-		i++;
-		btVector3 v2 = btVector3(
-			VBOs[bufferIndex][EBOs[bufferIndex][i] * VERTEX_SIZE],
-			VBOs[bufferIndex][EBOs[bufferIndex][i] * VERTEX_SIZE + 1],
-			VBOs[bufferIndex][EBOs[bufferIndex][i] * VERTEX_SIZE + 2]);
-		i++;
-		btVector3 v3 = btVector3(
-			VBOs[bufferIndex][EBOs[bufferIndex][i] * VERTEX_SIZE],
-			VBOs[bufferIndex][EBOs[bufferIndex][i] * VERTEX_SIZE + 1],
-			VBOs[bufferIndex][EBOs[bufferIndex][i] * VERTEX_SIZE + 2]);
-		i++;
-
-		triMesh->addTriangle(v1, v2, v3, true);
+	for (size_t c = 0; c < chunks.size(); c++) {
+		const IndexChunk& chunk = chunks[c];
+		// split meshes keep each chunk's vertices contiguous, up to the next chunk's base vertex
+		int chunkEnd = c + 1 < chunks.size() ? chunks[c + 1].baseVertex : vertexCount;
+
+		btIndexedMesh part;
+		part.m_numTriangles = chunk.indexCount / 3;
+		part.m_triangleIndexBase = (const unsigned char*)ebo.data() + chunk.firstIndex * ebo.indexSize();
+		part.m_triangleIndexStride = 3 * (int)ebo.indexSize();
+		part.m_numVertices = chunkEnd - chunk.baseVertex;
+		part.m_vertexBase = (const unsigned char*)&source.vbo[chunk.baseVertex * VERTEX_SIZE];
+		part.m_vertexStride = VERTEX_SIZE * sizeof(float);
+		part.m_vertexType = PHY_FLOAT;
+		triMesh->addIndexedMesh(part, ebo.wide ? PHY_INTEGER : PHY_SHORT);
 	}
 	return triMesh;
 }
 
-static btGeneric6DofConstraint* CreateGenericConstraint(btVector3 p1, btVector3 p2, btRigidBody &rb1, btRigidBody &rb2) {
+// straight from the basis and origin; going through getRotation() costs a matrix to quaternion conversion
+static glm::mat4 ModelMatrix(const btTransform& transform) {
+	glm::mat4 m;
+	transform.getOpenGLMatrix(glm::value_ptr(m));
+	return m;
+}
+
+// Coarsest LOD that stays within a small fraction of the mesh's size. Simplification can move the surface
+// toward the camera, and an occluder that sticks out hides things that should be seen.
+static unsigned int SelectOccluderLOD(const MeshAsset& asset) {
+	const float maxError = glm::length(asset.bounds.max - asset.bounds.min) * 0.002f;
+	unsigned int lod = 0;
+	while (lod + 1 < asset.lods.size() && asset.lods[lod + 1].error <= maxError)
+		lod++;
+	return lod;
+}
+
+static btGeneric6DofConstraint* CreateGenericConstraint(PhysicsPools& pools, btVector3 p1, btVector3 p2, btRigidBody &rb1, btRigidBody &rb2) {
 	btTransform frameInA = btTransform::getIdentity();
 	btTransform frameInB = btTransform::getIdentity();
 	frameInA.setOrigin(p1);
 	frameInB.setOrigin(p2);
-	btGeneric6DofConstraint* constr = new btGeneric6DofConstraint(rb1, rb2, frameInA, frameInB, true);
-	return constr;
+	return pools.constraints.Get(pools.constraints.Create(rb1, rb2, frameInA, frameInB, true));
 }
 
-static void InjectColorAttrib(glm::vec4 color, std::vector<float>& vertexBuffer) {
-	std::vector<float> temp;
-	for (int i = 0; i < vertexBuffer.size() / (VERTEX_SIZE - 4); i++) {
-		int vertIndex = i * (VERTEX_SIZE - 4);
-		temp.push_back(vertexBuffer[vertIndex + 0]); //push in position
-		temp.push_back(vertexBuffer[vertIndex + 1]);
-		temp.push_back(vertexBuffer[vertIndex + 2]);
-		temp.push_back(color.r); //push in color values
-		temp.push_back(color.g);
-		temp.push_back(color.b);
-		temp.push_back(color.a);
-		temp.push_back(vertexBuffer[vertIndex + 3]);
-		temp.push_back(vertexBuffer[vertIndex + 4]);
-		temp.push_back(vertexBuffer[vertIndex + 5]);
+static GLenum VertexFormatType(VertexFormat format) {
+	switch (format) {
+	case VertexFormat::Half4: return GL_HALF_FLOAT;
+	case VertexFormat::Snorm16x4:
+	case VertexFormat::OctSnorm16x2: return GL_SHORT;
+	case VertexFormat::Unorm8x4: return GL_UNSIGNED_BYTE;
+	default: return GL_FLOAT;
 	}
+}
+
+/// <summary>
+/// Points the bound VAO's attributes at the bound vertex buffer as described by layout.
+/// Semantics the layout doesn't store are left disabled until SetupInstanceAttributes points them at the instance buffer.
+/// </summary>
+static void SetupVertexLayout(const VertexLayout& layout, GLint posAttrib, GLint normalAttrib, GLint colorAttrib) {
+	const VertexSemantic semantics[3] = { VertexSemantic::Position, VertexSemantic::Normal, VertexSemantic::Color };
+	const GLint locations[3] = { posAttrib, normalAttrib, colorAttrib };
 
-	vertexBuffer = temp;
+	for (int i = 0; i < 3; i++) {
+		if (locations[i] < 0)
+			continue;
+		const VertexAttribute* attribute = layout.Find(semantics[i]);
+		if (!attribute) {
+			GLCALL(glDisableVertexAttribArray(locations[i]));
+			continue;
+		}
+		GLCALL(glVertexAttribPointer(locations[i], vertexFormatComponents(attribute->format), VertexFormatType(attribute->format),
+			vertexFormatNormalized(attribute->format) ? GL_TRUE : GL_FALSE, layout.stride, (void*)(size_t)attribute->offset));
+		GLCALL(glEnableVertexAttribArray(locations[i]));
+	}
 }
 
-static void ChangeColorAttrib(glm::vec4 color, std::vector<float>& vertexBuffer) {
-	for (int i = 0; i < vertexBuffer.size() / VERTEX_SIZE; i++) {
-		int vertIndex = i * VERTEX_SIZE;
-		vertexBuffer[vertIndex + 3] = color.r;
-		vertexBuffer[vertIndex + 4] = color.g;
-		vertexBuffer[vertIndex + 5] = color.b;
-		vertexBuffer[vertIndex + 6] = color.a;
+// Locations of the per-instance attributes; -1 for any the program doesn't use.
+struct InstanceAttributes {
+	GLint modelViewProj;
+	GLint model;
+	GLint normalMatrix;
+	GLint viewDepth;
+	GLint color; // only when the vertex layout has no color
+};
+
+// Points columns consecutive locations, a matrix attribute's columns, at consecutive vec4s of the instance.
+static void SetupInstanceAttribute(GLint location, int columns, int components, size_t offset) {
+	if (location < 0)
+		return;
+	for (int column = 0; column < columns; column++) {
+		GLCALL(glVertexAttribPointer(location + column, components, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+			(void*)(offset + column * sizeof(glm::vec4))));
+		GLCALL(glVertexAttribDivisor(location + column, 1));
+		GLCALL(glEnableVertexAttribArray(location + column));
 	}
 }
 
-int main(){
+/// <summary>
+/// Points the instance attributes at the instances written at instanceOffset in the bound buffer,
+/// starting firstInstance instances in. GL 3.3 has no base instance, so each group re-points them.
+/// </summary>
+static void SetupInstanceAttributes(const InstanceAttributes& attributes, size_t instanceOffset, unsigned int firstInstance) {
+	size_t base = instanceOffset + firstInstance * sizeof(InstanceData);
+	SetupInstanceAttribute(attributes.modelViewProj, 4, 4, base + offsetof(InstanceData, modelViewProjection));
+	SetupInstanceAttribute(attributes.model, 3, 4, base + offsetof(InstanceData, model));
+	SetupInstanceAttribute(attributes.normalMatrix, 3, 3, base + offsetof(InstanceData, normal));
+	SetupInstanceAttribute(attributes.viewDepth, 1, 4, base + offsetof(InstanceData, viewDepth));
+	SetupInstanceAttribute(attributes.color, 1, 4, base + offsetof(InstanceData, color));
+}
+
+int main(int argc, char** argv){
+	// --validate-meshes loads every mesh in a hidden window, checks the uploaded pool and exits with 0 if it matched
+	bool validateMeshes = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--benchmark") == 0) {
+			RunBenchmarks();
+			return 0;
+		}
+		if (strcmp(argv[i], "--selftest") == 0)
+			return RunSelfTests() == 0 ? 0 : 1;
+		if (strcmp(argv[i], "--validate-meshes") == 0)
+			validateMeshes = true;
+	}
+
 	GLFWwindow* window;
 
 	if (!glfwInit())
 		return -1;
 
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3); // instanced attributes need glVertexAttribDivisor
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+	glfwWindowHint(GLFW_VISIBLE, validateMeshes ? GLFW_FALSE : GLFW_TRUE);
+#if GL_DIAGNOSTICS
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 	window = glfwCreateWindow(1280, 720, "Bengine", nullptr, nullptr);
 
 	if (!window) {
@@ -223,25 +212,36 @@ int main(){
 		return -1;
 
 	std::cout << glGetString(GL_VERSION) << std::endl;
+#if GL_DIAGNOSTICS
+	if (!GLInstallDebugOutput())
+		std::cout << "KHR_debug unavailable, checking glGetError after every GL call" << std::endl;
+#endif
 
 #pragma region Create Shader Program
-	const std::string shaderProgramSource[2] = {
-		ParseShader("res/shaders/BasicVertex.shader"),
-		ParseShader("res/shaders/BasicFragment.shader")
-	};
+	ShaderProgramDesc basicProgram;
+	basicProgram.vertexPath = "res/shaders/BasicVertex.shader";
+	basicProgram.fragmentPath = "res/shaders/BasicFragment.shader";
 
-	GLuint shaderProgram = CreateShaderProgram(shaderProgramSource[0], shaderProgramSource[1]);
+	GLuint shaderProgram = loadShaderProgram(basicProgram);
+	if (!shaderProgram) {
+		glfwTerminate();
+		return -1;
+	}
 	GLCALL(glUseProgram(shaderProgram));
 #pragma endregion
 
 #pragma region physics init
 
-	//default setup for memory and collisions
+	// one pool of workers for the whole engine; Bullet's parallel loops run on it too
+	JobSystem jobs;
+	btSetTaskScheduler(&jobs);
+
+	//default setup for memory and collisions, with narrowphase, integration and islands spread over the jobs
 	btDefaultCollisionConfiguration* collisionConfiguration = new btDefaultCollisionConfiguration();
-	btCollisionDispatcher* dispatcher = new btCollisionDispatcher(collisionConfiguration);
+	btCollisionDispatcher* dispatcher = new btCollisionDispatcherMt(collisionConfiguration);
 	btBroadphaseInterface* overlappingPairCache = new btDbvtBroadphase();
-	btSequentialImpulseConstraintSolver* solver = new btSequentialImpulseConstraintSolver();
-	btDiscreteDynamicsWorld* dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, overlappingPairCache, solver, collisionConfiguration);
+	btConstraintSolverPoolMt* solver = new btConstraintSolverPoolMt(jobs.getNumThreads());
+	btDiscreteDynamicsWorld* dynamicsWorld = new btDiscreteDynamicsWorldMt(dispatcher, overlappingPairCache, solver, nullptr, collisionConfiguration);
 
 	dynamicsWorld->setGravity(btVector3(0, -10, 0));
 
@@ -249,7 +249,7 @@ int main(){
 
 #pragma region Declare meshes
 
-	std::vector<Mesh*> meshes;
+	Scene scene;
 	const char* meshFilePaths[]{
 		"models/smooth_suzanne.obj",
 		"models/cylinder.obj",
@@ -282,135 +282,132 @@ int main(){
 
 #pragma region Create Mesh Objects
 
-		//collider meshes (empty meshes that are used solely to fill space)	
-	//player Right Hand Anchor Collider
-	meshes.push_back(CreateMesh());
-
-	//player Left Hand Anchor Collider
-	meshes.push_back(CreateMesh());
-
-	//player Right Shoulder Collider
-	meshes.push_back(CreateMesh());
-
-	//player Left Shoulder Collider
-	meshes.push_back(CreateMesh());
-
 		//dynamic meshes (not deformable)
 	//smooth suzanne
-	meshes.push_back(CreateMesh("suzanne", SMOOTH_SUZANNE, Color::brownChocolate, meshes));
-	Mesh* mesh_suzanne = meshes[meshes.size() - 1];
+	Entity suzanne = CreateRenderEntity(scene, "suzanne", SMOOTH_SUZANNE, Color::brownChocolate);
 
 	//cylinder
-	meshes.push_back(CreateMesh("cylinder", CYLINDER, Color::blueBright, meshes));
-	Mesh* mesh_cylinder = meshes[meshes.size() - 1];
+	Entity cylinder = CreateRenderEntity(scene, "cylinder", CYLINDER, Color::blueBright);
 	
 	//icosphere
-	meshes.push_back(CreateMesh("icosphere", ICOSPHERE, Color::beige, meshes));
-	Mesh* mesh_icosphere = meshes[meshes.size() - 1];
+	Entity icosphere = CreateRenderEntity(scene, "icosphere", ICOSPHERE, Color::beige);
 
 	//player head
-	meshes.push_back(CreateMesh("player_head", PLAYER_HEAD, Color::brown, meshes));
-	Mesh* mesh_playerHead = meshes[meshes.size() - 1];
+	Entity player_head = CreateRenderEntity(scene, "player_head", PLAYER_HEAD, Color::brown);
 
 	//player hands
-	meshes.push_back(CreateMesh("player_handRight", PLAYER_HAND, Color::orangeTan, meshes));
-	Mesh* mesh_playerRightHand = meshes[meshes.size() - 1];
-
-	meshes.push_back(CreateMesh("player_handLeft", PLAYER_HAND, Color::orangeTan, meshes));
-	Mesh* mesh_playerLeftHand = meshes[meshes.size() - 1];
+	Entity player_handRight = CreateRenderEntity(scene, "player_handRight", PLAYER_HAND, Color::orangeTan);
+	Entity player_handLeft = CreateRenderEntity(scene, "player_handLeft", PLAYER_HAND, Color::orangeTan);
 
 	//player arms
-	meshes.push_back(CreateMesh("player_armRightUpper", PLAYER_ARM, Color::brown, meshes));
-	Mesh* player_armRightUpper = meshes[meshes.size() - 1];
-	meshes.push_back(CreateMesh("player_armRightLower", PLAYER_ARM, Color::brown, meshes));
-	Mesh* player_armRightLower = meshes[meshes.size() - 1];
-	meshes.push_back(CreateMesh("player_armLeftUpper", PLAYER_ARM, Color::brown, meshes));
-	Mesh* player_armLeftUpper = meshes[meshes.size() - 1];
-	meshes.push_back(CreateMesh("player_armLeftLower", PLAYER_ARM, Color::brown, meshes));
-	Mesh* player_armLeftLower = meshes[meshes.size() - 1];
+	Entity player_armRightUpper = CreateRenderEntity(scene, "player_armRightUpper", PLAYER_ARM, Color::brown);
+	Entity player_armRightLower = CreateRenderEntity(scene, "player_armRightLower", PLAYER_ARM, Color::brown);
+	Entity player_armLeftUpper = CreateRenderEntity(scene, "player_armLeftUpper", PLAYER_ARM, Color::brown);
+	Entity player_armLeftLower = CreateRenderEntity(scene, "player_armLeftLower", PLAYER_ARM, Color::brown);
 
 	//player joint
-	meshes.push_back(CreateMesh("player_jointRightElbow", PLAYER_JOINT, Color::orangeTan, meshes));
-	Mesh* player_jointRightElbow = meshes[meshes.size() - 1];
-	meshes.push_back(CreateMesh("player_jointRightWrist", PLAYER_JOINT, Color::orangeTan, meshes));
-	Mesh* player_jointRightWrist = meshes[meshes.size() - 1];
-	meshes.push_back(CreateMesh("player_jointLeftElbow", PLAYER_JOINT, Color::orangeTan, meshes));
-	Mesh* player_jointLeftElbow = meshes[meshes.size() - 1];
-	meshes.push_back(CreateMesh("player_jointLeftWrist", PLAYER_JOINT, Color::orangeTan, meshes));
-	Mesh* player_jointLeftWrist = meshes[meshes.size() - 1];
+	Entity player_jointRightElbow = CreateRenderEntity(scene, "player_jointRightElbow", PLAYER_JOINT, Color::orangeTan);
+	Entity player_jointRightWrist = CreateRenderEntity(scene, "player_jointRightWrist", PLAYER_JOINT, Color::orangeTan);
+	Entity player_jointLeftElbow = CreateRenderEntity(scene, "player_jointLeftElbow", PLAYER_JOINT, Color::orangeTan);
+	Entity player_jointLeftWrist = CreateRenderEntity(scene, "player_jointLeftWrist", PLAYER_JOINT, Color::orangeTan);
 
 		//Static members
 
 	//plane
-	meshes.push_back(CreateMesh("plane", PLANE, Color::greenForest, meshes));
-	Mesh* plane = meshes[meshes.size() - 1];
+	Entity plane = CreateRenderEntity(scene, "plane", PLANE, Color::greenForest);
 
 	//farm area
-	meshes.push_back(CreateMesh("farm_area", FARM_AREA, Color::greenYellow, meshes));
-	Mesh* farm_area = meshes[meshes.size() - 1];
+	Entity farm_area = CreateRenderEntity(scene, "farm_area", FARM_AREA, Color::greenYellow);
 
 	// farm house
-	meshes.push_back(CreateMesh("farm_house", FARM_HOUSE, Color::blueRoyal, meshes));
-	Mesh* farm_house = meshes[meshes.size() - 1];
+	Entity farm_house = CreateRenderEntity(scene, "farm_house", FARM_HOUSE, Color::blueRoyal);
 
 	// farm house roof
-	meshes.push_back(CreateMesh("farm_houseRoof", FARM_ROOF, Color::burlyWood, meshes));
-	Mesh* farm_houseRoof = meshes[meshes.size() - 1];
+	Entity farm_houseRoof = CreateRenderEntity(scene, "farm_houseRoof", FARM_ROOF, Color::burlyWood);
+
+	// the big static pieces hide most of the level from the ground; they keep their geometry for collision anyway
+	scene.renderMeshes.Get(farm_area).isOccluder = true;
+	scene.renderMeshes.Get(farm_house).isOccluder = true;
+	scene.renderMeshes.Get(farm_houseRoof).isOccluder = true;
 
 	//create cube rod stairs
+	Entity cubeRods[10];
 	for (int i = 0; i < 10; i++) {
-		meshes.push_back(CreateMesh("cube rod", CUBE_ROD, Color::gray, meshes));
+		cubeRods[i] = CreateRenderEntity(scene, "cube rod", CUBE_ROD, Color::gray);
 	}
 
 #pragma endregion
 
 #pragma region Load model files and create buffer objects
 
-	std::vector<GLfloat> rawVertexData;
-	std::vector<std::vector<GLfloat>> VBOs;
-	std::vector<std::vector<unsigned short>> EBOs;
-
-	for (int i = 0; i < meshes.size(); i++) {
-		//load models into raw vertex data vector
-		VBOs.push_back(std::vector<GLfloat>());
-		EBOs.push_back(std::vector<unsigned short>());
-		if (meshes[i]->empty)
-			continue;
-		loadOBJ(meshFilePaths[meshes[i]->meshIndex], rawVertexData);
-		InjectColorAttrib(meshes[i]->color, rawVertexData);
-		indexVBO(rawVertexData, EBOs[i], VBOs[i], VERTEX_SIZE);
-		rawVertexData.clear();
+	// meshes with more vertices than 16-bit indices can address are either drawn with 32-bit indices,
+	// or, when this is set, cut into 16-bit chunks drawn with a base vertex
+	const bool splitLargeMeshes = false;
+
+	// how vertices are packed for the GPU. Layouts without a color attribute take each mesh's color per instance,
+	// which also lets meshes with different colors share an asset.
+	const VertexLayout vertexLayout = VertexLayout::Get(VertexLayoutId::Compact);
+	const bool perInstanceColor = vertexLayout.Find(VertexSemantic::Color) == nullptr;
+
+	// meshes sharing a file and settings share one asset, and each asset is imported once
+	AssetRegistry assets;
+
+	for (size_t k = 0; k < scene.renderMeshes.Size(); k++) {
+		RenderMesh& mesh = scene.renderMeshes.At(k);
+		MeshImportSettings settings;
+		settings.layout = vertexLayout.id;
+		if (!perInstanceColor)
+			settings.color = scene.materials.Get(scene.renderMeshes.EntityAt(k)).color;
+		settings.splitLargeMeshes = splitLargeMeshes;
+		mesh.assetIndex = assets.RequestMesh(meshFilePaths[mesh.meshIndex], settings);
 	}
-	
-	//for (int i = 0; i < VBOs[mesh_suzanne->bufferIndex].size(); i++) {
-	//	std::cout << VBOs[mesh_suzanne->bufferIndex][i] << " ";
-	//	if (i % VERTEX_SIZE + 1 == 0 && i != 0)
-	//		std::cout << "\n";
-	//}
-
-	GLuint vao;
-	GLCALL(glGenVertexArrays(1, &vao));
-	GLCALL(glBindVertexArray(vao));
-
-	GLuint vbo;
-	GLCALL(glGenBuffers(1, &vbo));
-	GLCALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
-
-	GLuint ebo;
-	GLCALL(glGenBuffers(1, &ebo));
-	GLCALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo));
+	assets.LoadAll(jobs);
 
 	GLint posAttrib = glGetAttribLocation(shaderProgram, "vertexposition_local");
-	GLCALL(glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE * sizeof(GLfloat), (void*)0));
-	GLCALL(glEnableVertexAttribArray(posAttrib));
-
 	GLint colorAttrib = glGetAttribLocation(shaderProgram, "color");
-	GLCALL(glVertexAttribPointer(colorAttrib, 4, GL_FLOAT, GL_FALSE, VERTEX_SIZE * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat))));
-	GLCALL(glEnableVertexAttribArray(colorAttrib));
-
 	GLint normalAttrib = glGetAttribLocation(shaderProgram, "normal");
-	GLCALL(glVertexAttribPointer(normalAttrib, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE * sizeof(GLfloat), (void*)(7 * sizeof(GLfloat))));
-	GLCALL(glEnableVertexAttribArray(normalAttrib));
+
+	// every asset goes into one shared vertex and index buffer, drawn through a single vertex array
+	GpuMeshPool meshPool;
+	for (unsigned int i = 0; i < assets.MeshCount(); i++) {
+		MeshAsset& asset = assets.GetMesh(i);
+		asset.gpu = meshPool.Reserve(asset, vertexLayout.stride);
+	}
+
+	GLuint meshVertexArray;
+	GLCALL(glGenVertexArrays(1, &meshVertexArray));
+	GLCALL(glBindVertexArray(meshVertexArray));
+	meshPool.Upload();
+	SetupVertexLayout(vertexLayout, posAttrib, normalAttrib, colorAttrib);
+
+	if (validateMeshes) {
+		bool valid = meshPool.Validate();
+		std::cout << assets.MeshCount() << " meshes, " << meshPool.VertexBytes() << " vertex and " << meshPool.IndexBytes()
+			<< " index bytes uploaded: " << (valid ? "pool matches" : "pool DOESN'T match") << std::endl;
+		meshPool.Destroy();
+		glfwTerminate();
+		return valid ? 0 : 1;
+	}
+
+	// per-frame uniform blocks and instance attributes are all written into one ring
+	InstanceAttributes instanceAttributes;
+	instanceAttributes.modelViewProj = glGetAttribLocation(shaderProgram, "modelviewproj");
+	instanceAttributes.model = glGetAttribLocation(shaderProgram, "model");
+	instanceAttributes.normalMatrix = glGetAttribLocation(shaderProgram, "normalmatrix");
+	instanceAttributes.viewDepth = glGetAttribLocation(shaderProgram, "viewdepth");
+	instanceAttributes.color = perInstanceColor ? colorAttrib : -1;
+	TransformBatch transformBatch;
+	UniformRing frameRing;
+	frameRing.Create(64 * 1024);
+	RenderQueue renderQueue;
+
+#ifdef _DEBUG
+	if (!meshPool.Validate())
+		__debugbreak();
+#endif
+
+	GLCALL(glUniform1i(glGetUniformLocation(shaderProgram, "octahedralnormals"),
+		vertexLayout.Find(VertexSemantic::Normal)->format == VertexFormat::OctSnorm16x2));
 
 #pragma endregion
 
@@ -418,6 +415,7 @@ int main(){
 
 	//collision shapes
 	btAlignedObjectArray<btCollisionShape*> collisionShapes;
+	PhysicsPools physicsPools;
 	btCollisionShape* playerCapsuleShape = new btCapsuleShape(btScalar(1.0), btScalar(2.0));
 	btCollisionShape* sphereShape = new btSphereShape(btScalar(1.));
 	btCollisionShape* playerJointShape = new btSphereShape(btScalar(0.215));
@@ -426,175 +424,175 @@ int main(){
 	btCollisionShape* groundShape = new btBoxShape(btVector3(btScalar(10.), btScalar(0.05), btScalar(10.)));
 	btCollisionShape* cubeRodShape = new btBoxShape(btVector3(btScalar(1.), btScalar(0.2), btScalar(0.2)));
 
-	btBvhTriangleMeshShape* farm_areaShape = new btBvhTriangleMeshShape(GenerateTriangleCollisionMesh(EBOs, VBOs, *farm_area), true);
-	btBvhTriangleMeshShape* farm_houseShape = new btBvhTriangleMeshShape(GenerateTriangleCollisionMesh(EBOs, VBOs, *farm_house), true);
-	btBvhTriangleMeshShape* farm_houseRoofShape = new btBvhTriangleMeshShape(GenerateTriangleCollisionMesh(EBOs, VBOs, *farm_houseRoof), true);
+	const unsigned int farmAreaAsset = scene.renderMeshes.Get(farm_area).assetIndex;
+	const unsigned int farmHouseAsset = scene.renderMeshes.Get(farm_house).assetIndex;
+	const unsigned int farmRoofAsset = scene.renderMeshes.Get(farm_houseRoof).assetIndex;
+	btBvhTriangleMeshShape* farm_areaShape = new btBvhTriangleMeshShape(GenerateTriangleCollisionMesh(assets.GetMesh(farmAreaAsset)), true);
+	btBvhTriangleMeshShape* farm_houseShape = new btBvhTriangleMeshShape(GenerateTriangleCollisionMesh(assets.GetMesh(farmHouseAsset)), true);
+	btBvhTriangleMeshShape* farm_houseRoofShape = new btBvhTriangleMeshShape(GenerateTriangleCollisionMesh(assets.GetMesh(farmRoofAsset)), true);
+
+	// the GPU has its own copy now; only what the collision shapes above point into and what occluders
+	// rasterize stays on the CPU
+	std::vector<bool> keepCpuGeometry(assets.MeshCount(), false);
+	keepCpuGeometry[farmAreaAsset] = keepCpuGeometry[farmHouseAsset] = keepCpuGeometry[farmRoofAsset] = true;
+	for (size_t k = 0; k < scene.renderMeshes.Size(); k++) {
+		if (scene.renderMeshes.At(k).isOccluder)
+			keepCpuGeometry[scene.renderMeshes.At(k).assetIndex] = true;
+	}
+	for (unsigned int i = 0; i < assets.MeshCount(); i++)
+		releaseCpuGeometry(assets.GetMesh(i), keepCpuGeometry[i]);
 
 		//Colliders
 	//player capsule
-	CreateObject(btVector3(0, 3, 0), 5.0f,
+	Entity playerEntity = scene.Create("player");
+	btRigidBody* playerCapsuleObject = CreateObject(scene, physicsPools, playerEntity, btVector3(0, 3, 0), 5.0f,
 		playerCapsuleShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerCapsuleObject = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 	playerCapsuleObject->setAngularFactor(0);
 	playerCapsuleObject->setFriction(0);
 
 	//Right hand anchor collider
-	CreateObject(btVector3(0, 0, 0), 0.0f,
+	btRigidBody* playerRightHandAnchor = CreateObject(scene, physicsPools, scene.Create("player_handRightAnchor"), btVector3(0, 0, 0), 0.0f,
 		playerJointShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerRightHandAnchor = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 
 	//Left hand anchor collider
-	CreateObject(btVector3(0, 0, 0), 0.0f,
+	btRigidBody* playerLeftHandAnchor = CreateObject(scene, physicsPools, scene.Create("player_handLeftAnchor"), btVector3(0, 0, 0), 0.0f,
 		playerJointShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerLeftHandAnchor = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 
 	//Right shoulder anchor collider
-	CreateObject(btVector3(0, 0, 0), 0.0f,
+	btRigidBody* playerRightShoulderAnchor = CreateObject(scene, physicsPools, scene.Create("player_shoulderRightAnchor"), btVector3(0, 0, 0), 0.0f,
 		playerJointShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerRightShoulderAnchor = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 
 	playerRightShoulderAnchor->setIgnoreCollisionCheck(playerCapsuleObject, true);
 
 	//Left shoulder anchor collider
-	CreateObject(btVector3(0, 0, 0), 0.0f,
+	btRigidBody* playerLeftShoulderAnchor = CreateObject(scene, physicsPools, scene.Create("player_shoulderLeftAnchor"), btVector3(0, 0, 0), 0.0f,
 		playerJointShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerLeftShoulderAnchor = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 
 	playerLeftShoulderAnchor->setIgnoreCollisionCheck(playerCapsuleObject, true);
 
 	//smooth suzanne
-	CreateObject(btVector3(-3, 3, 0), 1.0f,
+	CreateObject(scene, physicsPools, suzanne, btVector3(-3, 3, 0), 1.0f,
 		sphereShape, collisionShapes, dynamicsWorld);
 
 	//cylinder
-	CreateObject(btVector3(1, 5, 0), 1.0f,
+	CreateObject(scene, physicsPools, cylinder, btVector3(1, 5, 0), 1.0f,
 		cylinderShape, collisionShapes, dynamicsWorld);
 
 	//icosphere
-	CreateObject(btVector3(-2, 7, 0), 1.0f,
+	CreateObject(scene, physicsPools, icosphere, btVector3(-2, 7, 0), 1.0f,
 		sphereShape, collisionShapes, dynamicsWorld);
 
 	//player head
-	CreateObject(btVector3(-4, 7, 0), 1.0f,
+	CreateObject(scene, physicsPools, player_head, btVector3(-4, 7, 0), 1.0f,
 		sphereShape, collisionShapes, dynamicsWorld);
 
 #pragma region hands
 	//player hand right
-	CreateObject(btVector3(-8, 7, 0), 0.2f,
+	btRigidBody* playerRightHand = CreateObject(scene, physicsPools, player_handRight, btVector3(-8, 7, 0), 0.2f,
 		playerArmShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerRightHand = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 	playerRightHand->setIgnoreCollisionCheck(playerRightHandAnchor, true);
 
-	dynamicsWorld->addConstraint(CreateGenericConstraint(btVector3(0, -0.12, 0), btVector3(0, 0, 0), *playerRightHand, *playerRightHandAnchor));
+	dynamicsWorld->addConstraint(CreateGenericConstraint(physicsPools, btVector3(0, -0.12, 0), btVector3(0, 0, 0), *playerRightHand, *playerRightHandAnchor));
 
 	//player hand left
-	CreateObject(btVector3(-8, 7, 0), 0.2f,
+	btRigidBody* playerLeftHand = CreateObject(scene, physicsPools, player_handLeft, btVector3(-8, 7, 0), 0.2f,
 		playerArmShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerLeftHand = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 	playerLeftHand->setIgnoreCollisionCheck(playerLeftHandAnchor, true);
 
-	dynamicsWorld->addConstraint(CreateGenericConstraint(btVector3(0, -0.12, 0), btVector3(0, 0, 0), *playerLeftHand, *playerLeftHandAnchor));
+	dynamicsWorld->addConstraint(CreateGenericConstraint(physicsPools, btVector3(0, -0.12, 0), btVector3(0, 0, 0), *playerLeftHand, *playerLeftHandAnchor));
 #pragma endregion
 #pragma region arms
 	//player arms
-	CreateObject(btVector3(-6, 7, 0), 0.05f,
+	btRigidBody* playerRightForearm = CreateObject(scene, physicsPools, player_armRightLower, btVector3(-6, 7, 0), 0.05f,
 		playerArmShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerRightForearm = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 	playerRightForearm->setIgnoreCollisionCheck(playerRightHand, true);
 
-	CreateObject(btVector3(-6, 7, 0), 0.05f,
+	btRigidBody* playerLeftForearm = CreateObject(scene, physicsPools, player_armLeftLower, btVector3(-6, 7, 0), 0.05f,
 		playerArmShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerLeftForearm = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 	playerLeftForearm->setIgnoreCollisionCheck(playerLeftHand, true);
 
-	CreateObject(btVector3(-6, 7, 0), 0.05f,
+	btRigidBody* playerRightUpperArm = CreateObject(scene, physicsPools, player_armRightUpper, btVector3(-6, 7, 0), 0.05f,
 		playerArmShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerRightUpperArm = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 	playerRightUpperArm->setIgnoreCollisionCheck(playerRightShoulderAnchor, true);
 	playerRightUpperArm->setIgnoreCollisionCheck(playerCapsuleObject, true);
 
-	dynamicsWorld->addConstraint(CreateGenericConstraint(btVector3(0, 0, 0), btVector3(0, -0.65, 0), *playerRightShoulderAnchor, *playerRightUpperArm)); // right shoulder and upper arm
+	dynamicsWorld->addConstraint(CreateGenericConstraint(physicsPools, btVector3(0, 0, 0), btVector3(0, -0.65, 0), *playerRightShoulderAnchor, *playerRightUpperArm)); // right shoulder and upper arm
 
-	CreateObject(btVector3(-6, 7, 0), 0.05f,
+	btRigidBody* playerLeftUpperArm = CreateObject(scene, physicsPools, player_armLeftUpper, btVector3(-6, 7, 0), 0.05f,
 		playerArmShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerLeftUpperArm = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 	playerLeftUpperArm->setIgnoreCollisionCheck(playerLeftShoulderAnchor, true);
 	playerLeftUpperArm->setIgnoreCollisionCheck(playerCapsuleObject, true);
 
-	dynamicsWorld->addConstraint(CreateGenericConstraint(btVector3(0, 0, 0), btVector3(0, -0.65, 0), *playerLeftShoulderAnchor, *playerLeftUpperArm)); // left shoulder and upper arm
+	dynamicsWorld->addConstraint(CreateGenericConstraint(physicsPools, btVector3(0, 0, 0), btVector3(0, -0.65, 0), *playerLeftShoulderAnchor, *playerLeftUpperArm)); // left shoulder and upper arm
 #pragma endregion
 #pragma region joints
 	//player joints
 	//right wrist
-	CreateObject(btVector3(-6, 7, 2), 0.05f,
+	btRigidBody* playerRightWrist = CreateObject(scene, physicsPools, player_jointRightWrist, btVector3(-6, 7, 2), 0.05f,
 		playerJointShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerRightWrist = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 	playerRightWrist->setIgnoreCollisionCheck(playerRightHand, true);
 	playerRightWrist->setIgnoreCollisionCheck(playerRightForearm, true);
 	playerRightWrist->setAngularFactor(0);
 
-	dynamicsWorld->addConstraint(CreateGenericConstraint(btVector3(0, 0, 0), btVector3(0, 0.65, 0), *playerRightWrist, *playerRightHand)); // right wrist and hand
+	dynamicsWorld->addConstraint(CreateGenericConstraint(physicsPools, btVector3(0, 0, 0), btVector3(0, 0.65, 0), *playerRightWrist, *playerRightHand)); // right wrist and hand
 
-	dynamicsWorld->addConstraint(CreateGenericConstraint(btVector3(0, 0, 0), btVector3(0, 0.65, 0), *playerRightWrist, *playerRightForearm)); // right wrist and forearm
+	dynamicsWorld->addConstraint(CreateGenericConstraint(physicsPools, btVector3(0, 0, 0), btVector3(0, 0.65, 0), *playerRightWrist, *playerRightForearm)); // right wrist and forearm
 
 	//left wrist
-	CreateObject(btVector3(-6, 7, 2), 0.05f,
+	btRigidBody* playerLeftWrist = CreateObject(scene, physicsPools, player_jointLeftWrist, btVector3(-6, 7, 2), 0.05f,
 		playerJointShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerLeftWrist = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 	playerLeftWrist->setIgnoreCollisionCheck(playerLeftHand, true);
 	playerLeftWrist->setIgnoreCollisionCheck(playerLeftForearm, true);
 	playerLeftWrist->setAngularFactor(0);
 
-	dynamicsWorld->addConstraint(CreateGenericConstraint(btVector3(0, 0, 0), btVector3(0, 0.65, 0), *playerLeftWrist, *playerLeftHand)); // left wrist and hand
+	dynamicsWorld->addConstraint(CreateGenericConstraint(physicsPools, btVector3(0, 0, 0), btVector3(0, 0.65, 0), *playerLeftWrist, *playerLeftHand)); // left wrist and hand
 
-	dynamicsWorld->addConstraint(CreateGenericConstraint(btVector3(0, 0, 0), btVector3(0, 0.65, 0), *playerLeftWrist, *playerLeftForearm)); // left wrist and forearm
+	dynamicsWorld->addConstraint(CreateGenericConstraint(physicsPools, btVector3(0, 0, 0), btVector3(0, 0.65, 0), *playerLeftWrist, *playerLeftForearm)); // left wrist and forearm
 
 	//right elbow
-	CreateObject(btVector3(-6, 7, 2), 0.05f,
+	btRigidBody* playerRightElbow = CreateObject(scene, physicsPools, player_jointRightElbow, btVector3(-6, 7, 2), 0.05f,
 		playerJointShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerRightElbow = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 	playerRightElbow->setIgnoreCollisionCheck(playerRightForearm, true);
 	playerRightElbow->setIgnoreCollisionCheck(playerRightUpperArm, true);
 	playerRightElbow->setAngularFactor(0);
 
-	dynamicsWorld->addConstraint(CreateGenericConstraint(btVector3(0, 0, 0), btVector3(0, -0.6, 0), *playerRightElbow, *playerRightForearm)); // right elbow and forearm
+	dynamicsWorld->addConstraint(CreateGenericConstraint(physicsPools, btVector3(0, 0, 0), btVector3(0, -0.6, 0), *playerRightElbow, *playerRightForearm)); // right elbow and forearm
 
-	dynamicsWorld->addConstraint(CreateGenericConstraint(btVector3(0, 0, 0), btVector3(0, 0.6, 0), *playerRightElbow, *playerRightUpperArm)); // right elbow and upper arm
+	dynamicsWorld->addConstraint(CreateGenericConstraint(physicsPools, btVector3(0, 0, 0), btVector3(0, 0.6, 0), *playerRightElbow, *playerRightUpperArm)); // right elbow and upper arm
 
 	//left elbow
-	CreateObject(btVector3(-6, 7, 2), 0.05f,
+	btRigidBody* playerLeftElbow = CreateObject(scene, physicsPools, player_jointLeftElbow, btVector3(-6, 7, 2), 0.05f,
 		playerJointShape, collisionShapes, dynamicsWorld);
-	btRigidBody* playerLeftElbow = btRigidBody::upcast(dynamicsWorld->getCollisionObjectArray()[dynamicsWorld->getNumCollisionObjects() - 1]);
 	playerLeftElbow->setIgnoreCollisionCheck(playerLeftForearm, true);
 	playerLeftElbow->setIgnoreCollisionCheck(playerLeftUpperArm, true);
 	playerLeftElbow->setAngularFactor(0);
 
-	dynamicsWorld->addConstraint(CreateGenericConstraint(btVector3(0, 0, 0), btVector3(0, -0.6, 0), *playerLeftElbow, *playerLeftForearm)); // left elbow and forearm
+	dynamicsWorld->addConstraint(CreateGenericConstraint(physicsPools, btVector3(0, 0, 0), btVector3(0, -0.6, 0), *playerLeftElbow, *playerLeftForearm)); // left elbow and forearm
 
-	dynamicsWorld->addConstraint(CreateGenericConstraint(btVector3(0, 0, 0), btVector3(0, 0.6, 0), *playerLeftElbow, *playerLeftUpperArm)); // left elbow and upper arm
+	dynamicsWorld->addConstraint(CreateGenericConstraint(physicsPools, btVector3(0, 0, 0), btVector3(0, 0.6, 0), *playerLeftElbow, *playerLeftUpperArm)); // left elbow and upper arm
 #pragma endregion
 
 		//Static members
 
 	//plane
-	CreateObject(btVector3(0, 0, 0), 0.0f,
+	CreateObject(scene, physicsPools, plane, btVector3(0, 0, 0), 0.0f,
 		groundShape, collisionShapes, dynamicsWorld);
 
 	// farm area
-	CreateObject(btVector3(60, -1, 0), 0.0f,
+	CreateObject(scene, physicsPools, farm_area, btVector3(60, -1, 0), 0.0f,
 		farm_areaShape, collisionShapes, dynamicsWorld);
 
 	// farm house
-	CreateObject(btVector3(72, 0, -5), 0.0f,
+	CreateObject(scene, physicsPools, farm_house, btVector3(72, 0, -5), 0.0f,
 		farm_houseShape, collisionShapes, dynamicsWorld);
 
 	// farm house roof
-	CreateObject(btVector3(79, 18.317, 0), 0.0f,
+	CreateObject(scene, physicsPools, farm_houseRoof, btVector3(79, 18.317, 0), 0.0f,
 		farm_houseRoofShape, collisionShapes, dynamicsWorld);
 
 	//create cube rod stairs
 	for (int i = 0; i < 10; i++) {
-		CreateObject(btVector3(-9 + (float)i * 2, 0.5 + (float)i / 2, 9.8), 0.0f,
+		CreateObject(scene, physicsPools, cubeRods[i], btVector3(-9 + (float)i * 2, 0.5 + (float)i / 2, 9.8), 0.0f,
 			cubeRodShape, collisionShapes, dynamicsWorld);
 	}
 
@@ -640,13 +638,10 @@ int main(){
 
 	//GLuint uniTime = glGetUniformLocation(shaderProgram, "time");
 
-	GLuint uniModel = glGetUniformLocation(shaderProgram, "model");
-	GLuint uniView = glGetUniformLocation(shaderProgram, "view");
-	GLuint uniProj = glGetUniformLocation(shaderProgram, "proj");
-
-	GLuint uniLightPos = glGetUniformLocation(shaderProgram, "lightposition_worldspace");
-	GLuint uniLightPower = glGetUniformLocation(shaderProgram, "lightpower");
-	GLuint uniLightColor = glGetUniformLocation(shaderProgram, "lightcolor");
+	const GLuint FRAME_UNIFORMS_BINDING = 0;
+	const GLuint DRAW_UNIFORMS_BINDING = 1;
+	GLCALL(glUniformBlockBinding(shaderProgram, glGetUniformBlockIndex(shaderProgram, "FrameData"), FRAME_UNIFORMS_BINDING));
+	GLCALL(glUniformBlockBinding(shaderProgram, glGetUniformBlockIndex(shaderProgram, "DrawData"), DRAW_UNIFORMS_BINDING));
 
 	//GLuint uniTexture = glGetUniformLocation(shaderProgram, "tex");
 
@@ -675,24 +670,127 @@ int main(){
 
 #pragma region Objects
 
-	glm::vec3 LightPosition_WorldSpace(0, 0, 1);
-	glm::vec3 LightColor(1, 1, 1);
-	GLfloat LightPower = 2.0f;
+	// lights[0] circles the spawn point; the rest orbit the level in a ring, each in its own color
+	const unsigned int ringLights = 128;
+	std::vector<PointLight> lights(1 + ringLights);
+	lights[0].color = glm::vec3(1, 1, 1);
+	lights[0].intensity = 2.0f;
+	for (unsigned int k = 1; k < lights.size(); k++) {
+		float hue = (float)k / ringLights * 6.2832f;
+		lights[k].color = glm::vec3(0.5f) + 0.5f * glm::vec3(cosf(hue), cosf(hue - 2.0944f), cosf(hue + 2.0944f));
+		lights[k].intensity = 0.5f;
+	}
+	for (PointLight& light : lights)
+		light.radius = pointLightRadius(light.intensity);
+
+	LightGrid lightGrid;
+	LightGridTextures lightGridTextures;
+	lightGridTextures.Create();
+	const GLuint LIGHT_GRID_TEXTURE_UNIT = 0;
+	GLCALL(glUniform1i(glGetUniformLocation(shaderProgram, "clusterlights"), LIGHT_GRID_TEXTURE_UNIT));
+	GLCALL(glUniform1i(glGetUniformLocation(shaderProgram, "lightindices"), LIGHT_GRID_TEXTURE_UNIT + 1));
+	GLCALL(glUniform1i(glGetUniformLocation(shaderProgram, "lights"), LIGHT_GRID_TEXTURE_UNIT + 2));
 
 #pragma endregion
 
 #pragma region Misc. variables
 
-	double t_last = 0.0;
 	double t_now = 0.0;
 	double fps_time = glfwGetTime();
-	float timeScale = 0.0f;
 	GLuint nbFrames = 0;
 
+	FrustumCuller frustumCuller;
+	std::vector<unsigned int> visibleMeshes;
+	CullStats cullStats;
+	OcclusionBuffer occlusionBuffer;
+	unsigned int occludedMeshes = 0;
+
+	GpuTimer gpuTimer;
+	const unsigned int meshPass = gpuTimer.AddPass("meshes");
+
+	// scratch for anything that only lives through a frame; one arena for this thread and one per worker
+	FrameArena frameArena(jobs.ThreadCount() + 1, 256 * 1024);
+
+#pragma endregion
+
+#pragma region Simulation
+
+	// Everything that touches the world each tick runs here, on the simulation thread. It keeps its own copy
+	// of the player for the arm and anchor state and publishes that state with each snapshot for the render thread's copy.
+	Player bodyPlayer = player;
+	SimulationThread simulation(dynamicsWorld, 1.0f / 60.0f, [&, bodyPlayer](const SimulationInput& input, float dt, SimulationOutput& out_output) mutable {
+		const glm::vec3& front = input.front;
+		const glm::vec3& right = input.right;
+		const glm::vec3& up = input.up;
+		btRigidBody* body = playerCapsuleObject;
+
+		if (input.move != glm::vec3(0.0f)) {
+			body->activate();
+			glm::vec3 adjustedFront = glm::normalize(glm::vec3(front.x, 0, front.z));
+			glm::vec3 adjustedRight = glm::normalize(glm::vec3(right.x, 0, right.z));
+			glm::vec3 adjustedUp = glm::normalize(glm::vec3(0, up.y, 0));
+			glm::vec3 force = adjustedRight * input.move.x + adjustedUp * input.move.y + adjustedFront * input.move.z;
+			body->applyCentralForce(Vec3ToBt(force) * bodyPlayer.speed * 1000);
+		}
+
+		//x + (y - x) * t
+		bodyPlayer.lArmExtend += ((input.leftArm ? bodyPlayer.armExtendMulti : 0) - bodyPlayer.lArmExtend) * bodyPlayer.armLerpT;
+		bodyPlayer.rArmExtend += ((input.rightArm ? bodyPlayer.armExtendMulti : 0) - bodyPlayer.rArmExtend) * bodyPlayer.armLerpT;
+
+		{ //do player model physics
+			bodyPlayer.position = BtToVec3(body->getWorldTransform().getOrigin());
+			playerRightHandAnchor->getWorldTransform().setOrigin(btVector3(Vec3ToBt(bodyPlayer.GetRArmAnchor(front, right, up)))); // set position of anchor collider to position of anchor world position
+			playerLeftHandAnchor->getWorldTransform().setOrigin(btVector3(Vec3ToBt(bodyPlayer.GetLArmAnchor(front, right, up))));
+			playerRightShoulderAnchor->getWorldTransform().setOrigin(btVector3(Vec3ToBt(bodyPlayer.GetRShoulderAnchor(right))));
+			playerLeftShoulderAnchor->getWorldTransform().setOrigin(btVector3(Vec3ToBt(bodyPlayer.GetLShoulderAnchor(right))));
+
+			const btVector3 playerModelGravity = Vec3ToBt(up) * -20;
+			playerRightHand->setGravity(playerModelGravity - Vec3ToBt(front) * 20);
+			playerRightHand->setAngularVelocity(btVector3(playerRightHand->getAngularVelocity().x(), 0.0, playerRightHand->getAngularVelocity().getZ()));
+			playerRightWrist->setGravity(playerModelGravity);
+			playerRightForearm->setGravity(playerModelGravity);
+			playerRightForearm->setAngularVelocity(btVector3(playerRightForearm->getAngularVelocity().x(), 0.0, playerRightForearm->getAngularVelocity().getZ()));
+			playerRightElbow->setGravity(playerModelGravity);
+			playerRightUpperArm->setGravity(playerModelGravity);
+			playerRightUpperArm->setAngularVelocity(btVector3(playerRightUpperArm->getAngularVelocity().x(), 0.0, playerRightUpperArm->getAngularVelocity().getZ()));
+
+			playerLeftHand->setGravity(playerModelGravity - Vec3ToBt(front) * 20);
+			playerLeftHand->setAngularVelocity(btVector3(playerLeftHand->getAngularVelocity().x(), 0.0, playerLeftHand->getAngularVelocity().getZ()));
+			playerLeftWrist->setGravity(playerModelGravity);
+			playerLeftForearm->setGravity(playerModelGravity);
+			playerLeftForearm->setAngularVelocity(btVector3(playerLeftForearm->getAngularVelocity().x(), 0.0, playerLeftForearm->getAngularVelocity().getZ()));
+			playerLeftElbow->setGravity(playerModelGravity);
+			playerLeftUpperArm->setGravity(playerModelGravity);
+			playerLeftUpperArm->setAngularVelocity(btVector3(playerLeftUpperArm->getAngularVelocity().x(), 0.0, playerLeftUpperArm->getAngularVelocity().getZ()));
+		}
+
+		{ //do player physics
+			btVector3 rayStart = body->getWorldTransform().getOrigin();
+			btVector3 rayEnd = rayStart + btVector3(0, -2, 0);
+			btCollisionWorld::ClosestRayResultCallback rayCallback(rayStart, rayEnd);
+			dynamicsWorld->rayTest(rayStart, rayEnd, rayCallback);
+			bodyPlayer.grounded = rayCallback.hasHit();
+
+			// the damping used to be applied once per rendered frame; now it is once per tick
+			btScalar damping = bodyPlayer.grounded ? 0.994 : 0.998;
+			body->setLinearVelocity(btVector3(body->getLinearVelocity().getX() * damping,
+				body->getLinearVelocity().getY(),
+				body->getLinearVelocity().getZ() * damping));
+		}
+
+		out_output.leftArmExtend = bodyPlayer.lArmExtend;
+		out_output.rightArmExtend = bodyPlayer.rArmExtend;
+		out_output.grounded = bodyPlayer.grounded;
+	});
+	simulation.Start();
+
 #pragma endregion
 
 	while (!glfwWindowShouldClose(window)) {
 
+		frameArena.BeginFrame();
+		LinearArena& frameMemory = frameArena.ForThread(0);
+
 		GLCALL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 		glClearColor(0.29f, 0.32f, 0.57f, 0.0f);
 
@@ -702,14 +800,16 @@ int main(){
 		nbFrames++;
 
 		if (t_now - fps_time >= 1.0) {
-			printf("%f ms/frame\n", 1000 / double(nbFrames));
+			printf("%f ms/frame, %u of %u objects culled, %u occluded, %u uniform ring stalls\n", 1000 / double(nbFrames), cullStats.Culled(),
+				cullStats.staticObjects + cullStats.dynamicObjects, occludedMeshes, frameRing.Stalls());
+			printf("  physics: %f ms/tick, %u ticks dropped\n", simulation.StepMilliseconds(), simulation.DroppedTicks());
+			printf("  frame arena: %u KB per thread, %u overflows\n", (unsigned int)(frameMemory.Capacity() / 1024), frameArena.Overflows());
+			for (unsigned int pass = 0; pass < gpuTimer.PassCount(); pass++)
+				printf("  gpu %s: %f ms\n", gpuTimer.Name(pass), gpuTimer.Milliseconds(pass));
 			nbFrames = 0;
 			fps_time += 1.0;
 		}
 
-		float dt = float(t_now - t_last) * timeScale;
-		t_last = glfwGetTime();
-
 #pragma endregion
 
 #pragma region camera and window
@@ -747,171 +847,58 @@ int main(){
 
 #pragma region input
 
-		if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-			//player.position += front * player.speed;
-			btCollisionObject* obj = dynamicsWorld->getCollisionObjectArray()[0]; // the first index of the collision objects array is always the player
-			btRigidBody* body = btRigidBody::upcast(obj);
-			body->activate();
-			btVector3 adjustedFront = Vec3ToBt(glm::normalize(glm::vec3(front.x, 0, front.z)));
-			body->applyCentralForce(player.speed * adjustedFront * 1000);
-		}
-		if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-			//player.position += right * -player.speed;
-			btCollisionObject* obj = dynamicsWorld->getCollisionObjectArray()[0];
-			btRigidBody* body = btRigidBody::upcast(obj);
-			body->activate();
-			btVector3 adjustedRight = Vec3ToBt(glm::normalize(glm::vec3(right.x, 0, right.z)));
-			body->applyCentralForce(-player.speed * adjustedRight * 1000);
-		}
-		if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-			//player.position += front * -player.speed;
-			btCollisionObject* obj = dynamicsWorld->getCollisionObjectArray()[0];
-			btRigidBody* body = btRigidBody::upcast(obj);
-			body->activate();
-			btVector3 adjustedFront = Vec3ToBt(glm::normalize(glm::vec3(front.x, 0, front.z)));
-			body->applyCentralForce(-player.speed * adjustedFront * 1000);
-		}
-		if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-			//player.position += right * player.speed;
-			btCollisionObject* obj = dynamicsWorld->getCollisionObjectArray()[0];
-			btRigidBody* body = btRigidBody::upcast(obj);
-			body->activate();
-			btVector3 adjustedRight = Vec3ToBt(glm::normalize(glm::vec3(right.x, 0, right.z)));
-			body->applyCentralForce(player.speed * adjustedRight * 1000);
-		}
-		if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
-			//player.position += up * player.speed;
-			btCollisionObject* obj = dynamicsWorld->getCollisionObjectArray()[0];
-			btRigidBody* body = btRigidBody::upcast(obj);
-			body->activate();
-			btVector3 adjustedUp = Vec3ToBt(glm::normalize(glm::vec3(0, up.y, 0)));
-			body->applyCentralForce(player.speed * adjustedUp * 1000);
-		}
-		if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
-			//player.position += up * -player.speed;
-			btCollisionObject* obj = dynamicsWorld->getCollisionObjectArray()[0];
-			btRigidBody* body = btRigidBody::upcast(obj);
-			body->activate();
-			btVector3 adjustedUp = Vec3ToBt(glm::normalize(glm::vec3(0, up.y, 0)));
-			body->applyCentralForce(-player.speed * adjustedUp * 1000);
-		}
-		if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
-			timeScale = 0.0f;
-		}
-		else
-			timeScale = 1.0f;
-
-		if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_1) == GLFW_PRESS) {
-			//x + (y - x) * t
-			player.lArmExtend += (player.armExtendMulti - player.lArmExtend) * player.armLerpT;
-		}
-		else {
-			player.lArmExtend += (0 - player.lArmExtend) * player.armLerpT;
-		}
-		if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_2) == GLFW_PRESS) {
-			player.rArmExtend += (player.armExtendMulti - player.rArmExtend) * player.armLerpT;
-		}
-		else {
-			player.rArmExtend += (0 - player.rArmExtend) * player.armLerpT;
-		}
+		// gather this frame's controls for the simulation thread, which applies them on its next tick
+		SimulationInput input;
+		input.front = front;
+		input.right = right;
+		input.up = up;
+		if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) input.move.z += 1.0f;
+		if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) input.move.z -= 1.0f;
+		if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) input.move.x += 1.0f;
+		if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) input.move.x -= 1.0f;
+		if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) input.move.y += 1.0f;
+		if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) input.move.y -= 1.0f;
+		input.paused = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+		input.leftArm = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_1) == GLFW_PRESS;
+		input.rightArm = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_2) == GLFW_PRESS;
+		simulation.SetInput(input);
 
 #pragma endregion
 
 #pragma region light
 
-		LightPosition_WorldSpace = glm::vec3(cos(t_now * 1.5), 1, sin(t_now * 1.5)) * 2.5f;
-
-		GLCALL(glUniform3f(uniLightPos, LightPosition_WorldSpace.x, LightPosition_WorldSpace.y, LightPosition_WorldSpace.z));
-		GLCALL(glUniform1f(uniLightPower, LightPower));
-		GLCALL(glUniform3f(uniLightColor, LightColor.x, LightColor.y, LightColor.z));
+		lights[0].position = glm::vec3(cos(t_now * 1.5), 1, sin(t_now * 1.5)) * 2.5f;
+		for (unsigned int k = 1; k < lights.size(); k++) {
+			float angle = (float)k / ringLights * 6.2832f + (float)t_now * 0.2f;
+			float ring = 10.0f + 6.0f * (k % 4);
+			lights[k].position = glm::vec3(cosf(angle) * ring, 1.5f + sinf((float)t_now + k), sinf(angle) * ring);
+		}
 
 #pragma endregion
 
 #pragma region physics
 
-		dynamicsWorld->stepSimulation(dt);
-
-		for (int i = dynamicsWorld->getNumCollisionObjects() - 1; i >= 1; i--) { // reserve the first spot for the player
-			btCollisionObject* obj = dynamicsWorld->getCollisionObjectArray()[i];
-			btRigidBody* body = btRigidBody::upcast(obj);
-			if (body && body->getMotionState()) {
-				body->getMotionState()->getWorldTransform(meshes[i - 1]->transform);
-			}
-			else {
-				meshes[i - 1]->transform = obj->getWorldTransform();
-			}
-			//printf("world pos object %d = %f,%f,%f\n", i, float(meshes[i].transform.getOrigin().getX()), float(meshes[i].transform.getOrigin().getY()), float(meshes[i].transform.getOrigin().getZ()));
-		}
-
-		{ //do player model physics
-			playerRightHandAnchor->getWorldTransform().setOrigin(btVector3(Vec3ToBt(player.GetRArmAnchor(front, right, up)))); // set position of anchor collider to position of anchor world position
-			playerLeftHandAnchor->getWorldTransform().setOrigin(btVector3(Vec3ToBt(player.GetLArmAnchor(front, right, up))));
-			playerRightShoulderAnchor->getWorldTransform().setOrigin(btVector3(Vec3ToBt(player.GetRShoulderAnchor(right))));
-			playerLeftShoulderAnchor->getWorldTransform().setOrigin(btVector3(Vec3ToBt(player.GetLShoulderAnchor(right))));
-
-			const btVector3 playerModelGravity = Vec3ToBt(up) * -20;
-			playerRightHand->setGravity(playerModelGravity - Vec3ToBt(front) * 20);
-			playerRightHand->setAngularVelocity(btVector3(playerRightHand->getAngularVelocity().x(), 0.0, playerRightHand->getAngularVelocity().getZ()));
-			playerRightWrist->setGravity(playerModelGravity);
-			playerRightForearm->setGravity(playerModelGravity);
-			playerRightForearm->setAngularVelocity(btVector3(playerRightForearm->getAngularVelocity().x(), 0.0, playerRightForearm->getAngularVelocity().getZ()));
-			playerRightElbow->setGravity(playerModelGravity);
-			playerRightUpperArm->setGravity(playerModelGravity);
-			playerRightUpperArm->setAngularVelocity(btVector3(playerRightUpperArm->getAngularVelocity().x(), 0.0, playerRightUpperArm->getAngularVelocity().getZ()));
-
-			playerLeftHand->setGravity(playerModelGravity - Vec3ToBt(front) * 20);
-			playerLeftHand->setAngularVelocity(btVector3(playerLeftHand->getAngularVelocity().x(), 0.0, playerLeftHand->getAngularVelocity().getZ()));
-			playerLeftWrist->setGravity(playerModelGravity);
-			playerLeftForearm->setGravity(playerModelGravity);
-			playerLeftForearm->setAngularVelocity(btVector3(playerLeftForearm->getAngularVelocity().x(), 0.0, playerLeftForearm->getAngularVelocity().getZ()));
-			playerLeftElbow->setGravity(playerModelGravity);
-			playerLeftUpperArm->setGravity(playerModelGravity);
-			playerLeftUpperArm->setAngularVelocity(btVector3(playerLeftUpperArm->getAngularVelocity().x(), 0.0, playerLeftUpperArm->getAngularVelocity().getZ()));
-		}
-
-		{ //do player physics
-			btCollisionObject* obj = dynamicsWorld->getCollisionObjectArray()[0];
-			btRigidBody* body = btRigidBody::upcast(obj);
-			if (body && body->getMotionState()) {
-				body->getMotionState()->getWorldTransform(player.transform);
-			}
-			else {
-				player.transform = obj->getWorldTransform();
-			}
-			
-			btVector3 rayStart = player.transform.getOrigin();
-			btVector3 rayEnd = player.transform.getOrigin() + btVector3(0, -2, 0);
-			btCollisionWorld::ClosestRayResultCallback rayCallback(rayStart, rayEnd);
-			dynamicsWorld->rayTest(rayStart, rayEnd, rayCallback);
-
-			if (rayCallback.hasHit())
-				player.grounded = true;
-			else
-				player.grounded = false;
-			//printf("%i\n", player.grounded);
-			if (player.grounded) {
-				body->setLinearVelocity(btVector3(body->getLinearVelocity().getX() * 0.994,
-					body->getLinearVelocity().getY(),
-					body->getLinearVelocity().getZ() * 0.994));
-			}
-			else
-				body->setLinearVelocity(btVector3(body->getLinearVelocity().getX() * 0.998,
-					body->getLinearVelocity().getY(),
-					body->getLinearVelocity().getZ() * 0.998));
-
-			//printf("world pos object = %f,%f,%f\n", float(player.transform.getOrigin().getX()), float(player.transform.getOrigin().getY()), float(player.transform.getOrigin().getZ()));
-			//std::cout << "start: " << rayStart.getX() << " " << rayStart.getY() << " " << rayStart.getZ() << std::endl;
-			//std::cout << "end: " << rayEnd.getX() << " " << rayEnd.getY() << " " << rayEnd.getZ() << std::endl;
-			//std::cout << rayCallback.hasHit() << std::endl;
+		// draw one tick behind the simulation, blending its last two poses
+		float alpha;
+		const TransformSnapshot& snapshot = simulation.Latest(alpha);
+		for (size_t k = 0; k < snapshot.owners.size(); k++) {
+			Entity owner;
+			owner.id = (unsigned int)snapshot.owners[k];
+			// objects of entities destroyed since the snapshot was taken no longer match
+			btTransform* transform = scene.transforms.Find(owner);
+			if (transform)
+				*transform = interpolatePose(snapshot.previous[k], snapshot.current[k], alpha);
 		}
+		player.transform = scene.transforms.Get(playerEntity);
+		player.lArmExtend = snapshot.output.leftArmExtend;
+		player.rArmExtend = snapshot.output.rightArmExtend;
+		player.grounded = snapshot.output.grounded;
 
 #pragma endregion
 
 #pragma region MVP matrices
 
-		// Model, view, and projection matrices
-		glm::mat4 model = glm::mat4(1.0f);
-
+		// View and projection matrices; each object's model matrices come out of the transform batch
 		glm::mat4 view = glm::lookAt(
 			BtToVec3(player.transform.getOrigin()) + player.cam_offset,
 			BtToVec3(player.transform.getOrigin()) + front + player.cam_offset,
@@ -920,8 +907,14 @@ int main(){
 
 		glm::mat4 proj = glm::perspective(glm::radians(player.fov), (float)windowX / (float)windowY, player.cam_near_clipping_plane, player.cam_far_clipping_plane);
 
-		GLCALL(glUniformMatrix4fv(uniProj, 1, GL_FALSE, glm::value_ptr(proj)));
-		GLCALL(glUniformMatrix4fv(uniView, 1, GL_FALSE, glm::value_ptr(view)));
+		// for LOD selection: how many pixels one unit covers at distance 1
+		glm::vec3 cameraPosition = BtToVec3(player.transform.getOrigin()) + player.cam_offset;
+		float pixelsPerUnit = (float)windowY / (2.0f * tanf(glm::radians(player.fov) * 0.5f));
+
+		// bin the lights into the view's clusters for the fragment shader on a worker, while this thread culls
+		lightGrid.SetProjection(glm::radians(player.fov), (float)windowX / (float)windowY, player.cam_near_clipping_plane, player.cam_far_clipping_plane);
+		JobCounter lightGridBuilt;
+		jobs.Run([&lightGrid, &lights, &frameArena, view]() { lightGrid.Build(lights, view, frameArena.Local()); }, &lightGridBuilt);
 
 #pragma endregion
 
@@ -931,46 +924,181 @@ int main(){
 
 #pragma endregion
 
-		for (int i = 0; i < meshes.size(); i++) {
-			if (meshes[i]->empty) 
+#pragma region Culling
+
+		// static meshes enter the culler's tree once; dynamic ones report their bounds every frame
+		// the culler knows objects by entity index
+		for (size_t k = 0; k < scene.renderMeshes.Size(); k++) {
+			Entity entity = scene.renderMeshes.EntityAt(k);
+			bool isStatic = scene.renderMeshes.At(k).isStatic;
+			if (isStatic && frustumCuller.Contains(entity.Index()))
 				continue;
+			const MeshAsset& asset = assets.GetMesh(scene.renderMeshes.At(k).assetIndex);
+			glm::vec3 worldMin, worldMax;
+			transformBounds(ModelMatrix(scene.transforms.Get(entity)), asset.bounds.min, asset.bounds.max, worldMin, worldMax);
+			if (isStatic)
+				frustumCuller.SetStatic(entity.Index(), worldMin, worldMax);
+			else
+				frustumCuller.SetDynamic(entity.Index(), worldMin, worldMax);
+		}
+
+		visibleMeshes.clear();
+		frustumCuller.Cull(Frustum::FromMatrix(proj * view), visibleMeshes, &cullStats);
 
-			glm::mat4 specificModel = model;
+		// rasterize the visible occluders on the CPU, then drop everything that is hidden behind them
+		occlusionBuffer.Clear();
+		for (unsigned int i : visibleMeshes) {
+			Entity entity = scene.EntityAt(i);
+			const RenderMesh& mesh = scene.renderMeshes.Get(entity);
+			if (!mesh.isOccluder)
+				continue;
+			const MeshAsset& asset = assets.GetMesh(mesh.assetIndex);
+			// made an occluder after its geometry was released: it still draws, it just hides nothing
+			if (asset.vbo.empty())
+				continue;
+			glm::mat4 mvp = proj * view * ModelMatrix(scene.transforms.Get(entity));
+			if (asset.ebo.chunks.empty()) {
+				const MeshLOD& lod = asset.lods[SelectOccluderLOD(asset)];
+				occlusionBuffer.RasterizeOccluder(&asset.vbo[0], VERTEX_SIZE, asset.ebo, lod.firstIndex, lod.indexCount, 0, mvp);
+			}
+			else {
+				for (const IndexChunk& chunk : asset.ebo.chunks)
+					occlusionBuffer.RasterizeOccluder(&asset.vbo[0], VERTEX_SIZE, asset.ebo, chunk.firstIndex, chunk.indexCount, chunk.baseVertex, mvp);
+			}
+		}
+		occlusionBuffer.UpdateHierarchy();
+
+		size_t unoccluded = 0;
+		for (unsigned int i : visibleMeshes) {
+			Entity entity = scene.EntityAt(i);
+			const RenderMesh& mesh = scene.renderMeshes.Get(entity);
+			if (!mesh.isOccluder) {
+				const MeshAsset& asset = assets.GetMesh(mesh.assetIndex);
+				glm::vec3 worldMin, worldMax;
+				transformBounds(ModelMatrix(scene.transforms.Get(entity)), asset.bounds.min, asset.bounds.max, worldMin, worldMax);
+				if (!occlusionBuffer.IsVisible(worldMin, worldMax, proj * view))
+					continue;
+			}
+			visibleMeshes[unoccluded++] = i;
+		}
+		occludedMeshes = (unsigned int)(visibleMeshes.size() - unoccluded);
+		visibleMeshes.resize(unoccluded);
 
-			glm::vec3 p(
-				meshes[i]->transform.getOrigin().getX(), 
-				meshes[i]->transform.getOrigin().getY(), 
-				meshes[i]->transform.getOrigin().getZ());
-			glm::quat o(
-				meshes[i]->transform.getRotation().getW(),
-				meshes[i]->transform.getRotation().getX(),
-				meshes[i]->transform.getRotation().getY(),
-				meshes[i]->transform.getRotation().getZ());	
+#pragma endregion
 
-			glm::mat4 translate = glm::translate(p);
-			glm::mat4 rotate = glm::toMat4(o);
-			glm::mat4 scale = glm::scale(glm::vec3(1, 1, 1));
+		jobs.Wait(lightGridBuilt);
+		lightGridTextures.Upload(lightGrid, lights);
+		lightGridTextures.Bind(LIGHT_GRID_TEXTURE_UNIT);
 
-			specificModel = translate * rotate;
+		// every visible object's matrices in one SIMD pass
+		transformBatch.Resize(visibleMeshes.size());
+		for (size_t v = 0; v < visibleMeshes.size(); v++)
+			transformBatch.Set(v, scene.transforms.Get(scene.EntityAt(visibleMeshes[v])));
+		transformBatch.Compute(view, proj);
 
-			GLCALL(glUniformMatrix4fv(uniModel, 1, GL_FALSE, glm::value_ptr(specificModel)));
+		// extract a keyed command per visible object on the workers; only the submit below touches GL
+		const float farPlane = player.cam_far_clipping_plane;
+		renderQueue.Build(jobs, visibleMeshes.size(), [&](size_t v, InstanceData& out_instance) -> unsigned long long {
+			Entity entity = scene.EntityAt(visibleMeshes[v]);
+			const RenderMesh& mesh = scene.renderMeshes.Get(entity);
 
 			//GLCALL(glActiveTexture(GL_TEXTURE0 + meshes[i]->textureID));
 			//GLCALL(glBindTexture(GL_TEXTURE_2D, textures[meshes[i]->textureID])); // BIND TEXTURE
 			//GLCALL(glUniform1i(uniTexture, meshes[i]->textureID));
 			
-			GLCALL(glBufferData(GL_ARRAY_BUFFER, VBOs[i].size() * sizeof(GLfloat), &VBOs[i][0], GL_STATIC_DRAW));
-			GLCALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, EBOs[i].size() * sizeof(unsigned short), &EBOs[i][0], GL_STATIC_DRAW));
+			const MeshAsset& asset = assets.GetMesh(mesh.assetIndex);
+
+			// measure from the nearest point of the bounding sphere, so big meshes like the terrain stay detailed up close
+			glm::vec3 boundsCenter = BtToVec3(scene.transforms.Get(entity) * Vec3ToBt((asset.bounds.min + asset.bounds.max) * 0.5f));
+			float boundsRadius = glm::length(asset.bounds.max - asset.bounds.min) * 0.5f;
+			float distance = glm::max(glm::length(boundsCenter - cameraPosition) - boundsRadius, player.cam_near_clipping_plane);
+			unsigned int lod = asset.ebo.chunks.empty() ? selectMeshLOD(asset, distance, pixelsPerUnit) : 0;
+
+			transformBatch.GetInstance(v, out_instance);
+			out_instance.color = scene.materials.Get(entity).color;
+			return RenderKey::Make(0, 0, mesh.assetIndex, lod, distance / farPlane);
+		});
+		renderQueue.Sort();
+
+		// write the frame's uniforms, instances and per-draw uniforms into this frame's part of the ring
+		const std::vector<InstanceData>& instances = renderQueue.Instances();
+		const std::vector<InstanceGroup>& groups = renderQueue.Groups();
+		frameRing.BeginFrame(frameRing.AlignedSize(sizeof(FrameUniforms)) + frameRing.AlignedSize(instances.size() * sizeof(InstanceData))
+			+ groups.size() * frameRing.AlignedSize(sizeof(DrawUniforms)));
+
+		FrameUniforms frameUniforms;
+		frameUniforms.view = view;
+		frameUniforms.proj = proj;
+		frameUniforms.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+		frameUniforms.clusterScale = glm::vec4(lightGrid.SliceScale(), lightGrid.SliceBias(),
+			(float)LightGrid::TILES_X / windowX, (float)LightGrid::TILES_Y / windowY);
+		frameUniforms.clusterCount = glm::uvec4(LightGrid::TILES_X, LightGrid::TILES_Y, LightGrid::SLICES, 0);
+		size_t frameUniformOffset = frameRing.Push(frameUniforms);
+
+		void* instanceData;
+		size_t instanceOffset = frameRing.Allocate(instances.size() * sizeof(InstanceData), &instanceData);
+		if (!instances.empty())
+			memcpy(instanceData, &instances[0], instances.size() * sizeof(InstanceData));
+
+		ArenaVector<size_t> drawUniformOffsets(groups.size(), 0, ArenaAllocator<size_t>(frameMemory));
+		for (size_t g = 0; g < groups.size(); g++) {
+			const MeshAsset& asset = assets.GetMesh(groups[g].assetIndex);
+			DrawUniforms drawUniforms;
+			vertexPositionDecode(vertexLayout, asset.bounds.min, asset.bounds.max, drawUniforms.positionOffset, drawUniforms.positionScale);
+			drawUniformOffsets[g] = frameRing.Push(drawUniforms);
+		}
+		frameRing.Flush();
+
+		// whatever didn't fit in the ring isn't drawn this frame; the ring grows for the next one
+		bool frameFits = frameUniformOffset != UniformRing::OVERFLOWED && instanceOffset != UniformRing::OVERFLOWED;
+		if (frameFits)
+			GLCALL(glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, frameRing.Buffer(), frameUniformOffset, sizeof(FrameUniforms)));
+		GLCALL(glBindBuffer(GL_ARRAY_BUFFER, frameRing.Buffer()));
+
+		// one instanced draw per asset and LOD (per chunk for split meshes)
+		gpuTimer.Begin(meshPass);
+		for (size_t g = 0; g < groups.size(); g++) {
+			if (!frameFits || drawUniformOffsets[g] == UniformRing::OVERFLOWED)
+				continue;
+			const InstanceGroup& group = groups[g];
+			const MeshAsset& asset = assets.GetMesh(group.assetIndex);
 
-			glDrawElements(GL_TRIANGLES, EBOs[i].size(), GL_UNSIGNED_SHORT, (void*)0);
+			GLCALL(glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_UNIFORMS_BINDING, frameRing.Buffer(), drawUniformOffsets[g], sizeof(DrawUniforms)));
+			SetupInstanceAttributes(instanceAttributes, instanceOffset, group.firstInstance);
+
+			if (asset.ebo.chunks.empty()) {
+				const MeshLOD& lod = asset.lods[group.lod];
+				glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lod.indexCount, asset.ebo.wide ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT,
+					(void*)(asset.gpu.indexOffset + lod.firstIndex * asset.ebo.indexSize()), group.instanceCount, asset.gpu.baseVertex);
+			}
+			else {
+				for (const IndexChunk& chunk : asset.ebo.chunks)
+					glDrawElementsInstancedBaseVertex(GL_TRIANGLES, chunk.indexCount, GL_UNSIGNED_SHORT,
+						(void*)(asset.gpu.indexOffset + chunk.firstIndex * sizeof(unsigned short)), group.instanceCount, asset.gpu.baseVertex + chunk.baseVertex);
+			}
 		}
+		gpuTimer.End();
+		gpuTimer.EndFrame();
+		frameRing.EndFrame();
 
 		glfwSwapBuffers(window);
 
 		glfwPollEvents();
 	}
 
-	GLCALL(glDeleteProgram(shaderProgram))
+	simulation.Stop();
+
+	// with the simulation stopped the bodies go right away, so every body and constraint is back in the pools
+	// before the world goes away
+	while (scene.transforms.Size() > 0)
+		destroyEntity(scene, simulation, physicsPools, scene.transforms.EntityAt(scene.transforms.Size() - 1), &frustumCuller);
+
+	GLCALL(glDeleteProgram(shaderProgram));
+	gpuTimer.Destroy();
+	frameRing.Destroy();
+	lightGridTextures.Destroy();
+	GLCALL(glDeleteVertexArrays(1, &meshVertexArray));
+	meshPool.Destroy();
 
 	glfwTerminate();
 
@@ -979,6 +1107,7 @@ int main(){
 	delete overlappingPairCache;
 	delete dispatcher;
 	delete collisionConfiguration;
+	btSetTaskScheduler(nullptr);
 
 	return 0;
 }
\ No newline at end of file
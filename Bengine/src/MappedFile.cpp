@@ -0,0 +1,106 @@
+#include "headers/MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* path) {
+	Close();
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappedSize = (size_t)size.QuadPart;
+	isOpen = true;
+	if (mappedSize == 0) // empty files can't be mapped, but are valid
+		return true;
+
+	mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle)
+		mappedData = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!mappedData) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close() {
+	if (mappedData)
+		UnmapViewOfFile(mappedData);
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	if (fileHandle)
+		CloseHandle(fileHandle);
+	mappedData = nullptr;
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+	mappedSize = 0;
+	isOpen = false;
+}
+
+#else
+
+bool MappedFile::Open(const char* path) {
+	Close();
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return false;
+	}
+
+	fileDescriptor = fd;
+	mappedSize = (size_t)info.st_size;
+	isOpen = true;
+	if (mappedSize == 0)
+		return true;
+
+	void* mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (mapping == MAP_FAILED) {
+		Close();
+		return false;
+	}
+	madvise(mapping, mappedSize, MADV_SEQUENTIAL);
+	mappedData = (const char*)mapping;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (mappedData)
+		munmap((void*)mappedData, mappedSize);
+	if (fileDescriptor >= 0)
+		close(fileDescriptor);
+	mappedData = nullptr;
+	fileDescriptor = -1;
+	mappedSize = 0;
+	isOpen = false;
+}
+
+#endif
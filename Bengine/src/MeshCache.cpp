@@ -0,0 +1,362 @@
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "headers/MeshCache.hpp"
+#include "headers/MappedFile.hpp"
+#include "headers/OBJLoader.hpp"
+#include "headers/Hash.hpp"
+#include "headers/MeshOptimizer.hpp"
+#include "headers/MeshSimplifier.hpp"
+
+static const char BAKED_MESH_MAGIC[4] = { 'B', 'M', 'S', 'H' };
+static const unsigned int BAKED_MESH_FORMAT_VERSION = 3;
+
+// File layout: header, then vertices, packed vertices, indices, chunks and LODs at the offsets it records.
+// Every section is 16-byte aligned so the mapping can be handed to GL as is.
+struct BakedMeshHeader {
+	char magic[4];
+	unsigned int formatVersion;
+	unsigned int importerVersion;
+	unsigned int vertexSize; // floats per vertex
+	unsigned long long sourceHash; // source file, importer version and import settings
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int indexSize; // bytes per index, 2 or 4
+	unsigned int chunkCount;
+	unsigned int lodCount;
+	unsigned int layoutId; // VertexLayoutId of the packed vertices
+	unsigned int packedStride;
+	float boundsMin[3];
+	float boundsMax[3];
+	unsigned long long vertexOffset;
+	unsigned long long packedOffset;
+	unsigned long long indexOffset;
+	unsigned long long chunkOffset;
+	unsigned long long lodOffset;
+};
+
+static unsigned long long alignTo16(unsigned long long offset) {
+	return (offset + 15) & ~15ULL;
+}
+
+unsigned long long meshSettingsHash(const MeshImportSettings& settings) {
+	unsigned long long hash = hashValue(settings.layout);
+	hash = hashValue(settings.color, hash);
+	hash = hashValue(settings.splitLargeMeshes, hash);
+	hash = hashValue(settings.optimizeVertexCache, hash);
+	hash = hashValue(settings.optimizeOverdraw, hash);
+	hash = hashValue(settings.lodCount, hash);
+	hash = hashValue(settings.lodReduction, hash);
+	return hash;
+}
+
+bool operator==(const MeshImportSettings& a, const MeshImportSettings& b) {
+	return a.layout == b.layout
+		&& a.color == b.color
+		&& a.splitLargeMeshes == b.splitLargeMeshes
+		&& a.optimizeVertexCache == b.optimizeVertexCache
+		&& a.optimizeOverdraw == b.optimizeOverdraw
+		&& a.lodCount == b.lodCount
+		&& a.lodReduction == b.lodReduction;
+}
+
+// the settings plus everything in the importer that changes what they produce
+static unsigned long long settingsKey(const MeshImportSettings& settings) {
+	unsigned long long hash = hashValue(MESH_IMPORTER_VERSION);
+	hash = hashValue(VERTEX_SIZE, hash);
+	return hashValue(meshSettingsHash(settings), hash);
+}
+
+// One file per source and settings, so imports of the same OBJ with different settings neither evict
+// each other nor write the same temporary file, while a changed source overwrites its entry.
+static std::string cachePathFor(const char* objPath, const MeshImportSettings& settings) {
+	std::string path(objPath);
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+		path.erase(dot);
+
+	char suffix[24];
+	snprintf(suffix, sizeof(suffix), ".%016llx", settingsKey(settings));
+	return path + suffix + ".bmesh";
+}
+
+static unsigned long long importKey(const MappedFile& source, const MeshImportSettings& settings) {
+	return hashValue(settingsKey(settings), hashBytes(source.Data(), source.Size()));
+}
+
+// whether size bytes at offset lie inside a file of fileSize bytes, without the sum wrapping
+static bool sectionFits(unsigned long long offset, unsigned long long size, unsigned long long fileSize) {
+	return offset <= fileSize && size <= fileSize - offset;
+}
+
+// whether every index in [first, first + count) plus baseVertex names one of vertexCount vertices
+template <typename Index>
+static bool indicesInRange(const Index* indices, unsigned long long first, unsigned long long count, long long baseVertex, unsigned long long vertexCount) {
+	for (unsigned long long i = first; i < first + count; i++) {
+		long long vertex = (long long)indices[i] + baseVertex;
+		if (vertex < 0 || (unsigned long long)vertex >= vertexCount)
+			return false;
+	}
+	return true;
+}
+
+static bool loadBakedMesh(const std::string& cachePath, unsigned long long key, const VertexLayout& layout, ImportedMesh& out_mesh) {
+
+	MappedFile file;
+	if (!file.Open(cachePath.c_str()) || file.Size() < sizeof(BakedMeshHeader))
+		return false;
+
+	BakedMeshHeader header;
+	memcpy(&header, file.Data(), sizeof(header));
+	if (memcmp(header.magic, BAKED_MESH_MAGIC, sizeof(header.magic)) != 0 ||
+		header.formatVersion != BAKED_MESH_FORMAT_VERSION ||
+		header.importerVersion != MESH_IMPORTER_VERSION ||
+		header.vertexSize != VERTEX_SIZE ||
+		header.sourceHash != key ||
+		header.layoutId != (unsigned int)layout.id ||
+		header.packedStride != layout.stride ||
+		(header.indexSize != 2 && header.indexSize != 4))
+		return false;
+
+	unsigned long long vertexBytes = (unsigned long long)header.vertexCount * header.vertexSize * sizeof(float);
+	unsigned long long packedBytes = (unsigned long long)header.vertexCount * header.packedStride;
+	unsigned long long indexBytes = (unsigned long long)header.indexCount * header.indexSize;
+	unsigned long long chunkBytes = (unsigned long long)header.chunkCount * sizeof(IndexChunk);
+	unsigned long long lodBytes = (unsigned long long)header.lodCount * sizeof(MeshLOD);
+	if (!sectionFits(header.vertexOffset, vertexBytes, file.Size()) ||
+		!sectionFits(header.packedOffset, packedBytes, file.Size()) ||
+		!sectionFits(header.indexOffset, indexBytes, file.Size()) ||
+		!sectionFits(header.chunkOffset, chunkBytes, file.Size()) ||
+		!sectionFits(header.lodOffset, lodBytes, file.Size()) ||
+		header.lodCount == 0 ||
+		(header.chunkCount > 0 && header.indexSize != 2)) // chunks are drawn with 16-bit indices
+		return false;
+
+	// the draws and the occlusion rasterizer trust every range and index, so a damaged file is rebaked
+	// rather than read past its ends
+	const unsigned char* indexData = (const unsigned char*)(file.Data() + header.indexOffset);
+	const IndexChunk* chunks = (const IndexChunk*)(file.Data() + header.chunkOffset);
+	const MeshLOD* lods = (const MeshLOD*)(file.Data() + header.lodOffset);
+	for (unsigned int i = 0; i < header.lodCount; i++) {
+		if ((unsigned long long)lods[i].firstIndex + lods[i].indexCount > header.indexCount)
+			return false;
+	}
+	if (header.chunkCount == 0) {
+		bool inRange = header.indexSize == 4
+			? indicesInRange((const unsigned int*)indexData, 0, header.indexCount, 0, header.vertexCount)
+			: indicesInRange((const unsigned short*)indexData, 0, header.indexCount, 0, header.vertexCount);
+		if (!inRange)
+			return false;
+	}
+	for (unsigned int i = 0; i < header.chunkCount; i++) {
+		const IndexChunk& chunk = chunks[i];
+		if ((unsigned long long)chunk.firstIndex + chunk.indexCount > header.indexCount ||
+			chunk.baseVertex < 0 || (unsigned long long)chunk.baseVertex > header.vertexCount ||
+			!indicesInRange((const unsigned short*)indexData, chunk.firstIndex, chunk.indexCount, chunk.baseVertex, header.vertexCount))
+			return false;
+	}
+
+	const float* vertices = (const float*)(file.Data() + header.vertexOffset);
+	out_mesh.vbo.assign(vertices, vertices + header.vertexCount * header.vertexSize);
+
+	const unsigned char* packed = (const unsigned char*)(file.Data() + header.packedOffset);
+	out_mesh.gpuVertices.assign(packed, packed + packedBytes);
+
+	IndexBuffer& ebo = out_mesh.ebo;
+	ebo.clear();
+	ebo.wide = header.indexSize == 4;
+	if (ebo.wide) {
+		const unsigned int* indices = (const unsigned int*)(file.Data() + header.indexOffset);
+		ebo.indices32.assign(indices, indices + header.indexCount);
+	}
+	else {
+		const unsigned short* indices = (const unsigned short*)(file.Data() + header.indexOffset);
+		ebo.indices16.assign(indices, indices + header.indexCount);
+	}
+	ebo.chunks.assign(chunks, chunks + header.chunkCount);
+
+	out_mesh.lods.assign(lods, lods + header.lodCount);
+
+	out_mesh.bounds.min = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	out_mesh.bounds.max = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	return true;
+}
+
+static bool writePadded(FILE* file, const void* data, size_t size, unsigned long long& offset) {
+	static const char zeros[16] = {};
+	unsigned long long aligned = alignTo16(offset);
+	if (aligned != offset && fwrite(zeros, 1, (size_t)(aligned - offset), file) != aligned - offset)
+		return false;
+	offset = aligned + size;
+	return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+static bool bakeMesh(const std::string& cachePath, unsigned long long key, const VertexLayout& layout, const ImportedMesh& mesh) {
+
+	const std::vector<float>& vbo = mesh.vbo;
+	const IndexBuffer& ebo = mesh.ebo;
+
+	BakedMeshHeader header = {};
+	memcpy(header.magic, BAKED_MESH_MAGIC, sizeof(header.magic));
+	header.formatVersion = BAKED_MESH_FORMAT_VERSION;
+	header.importerVersion = MESH_IMPORTER_VERSION;
+	header.vertexSize = VERTEX_SIZE;
+	header.sourceHash = key;
+	header.vertexCount = (unsigned int)(vbo.size() / VERTEX_SIZE);
+	header.indexCount = (unsigned int)ebo.size();
+	header.indexSize = (unsigned int)ebo.indexSize();
+	header.chunkCount = (unsigned int)ebo.chunks.size();
+	header.lodCount = (unsigned int)mesh.lods.size();
+	header.layoutId = (unsigned int)layout.id;
+	header.packedStride = layout.stride;
+	for (int k = 0; k < 3; k++) {
+		header.boundsMin[k] = mesh.bounds.min[k];
+		header.boundsMax[k] = mesh.bounds.max[k];
+	}
+	header.vertexOffset = alignTo16(sizeof(header));
+	header.packedOffset = alignTo16(header.vertexOffset + vbo.size() * sizeof(float));
+	header.indexOffset = alignTo16(header.packedOffset + mesh.gpuVertices.size());
+	header.chunkOffset = alignTo16(header.indexOffset + ebo.byteSize());
+	header.lodOffset = alignTo16(header.chunkOffset + ebo.chunks.size() * sizeof(IndexChunk));
+
+	// write to a temporary file and swap it in, so a crash never leaves a half written cache
+	std::string tempPath = cachePath + ".tmp";
+	FILE* file = NULL;
+	fopen_s(&file, tempPath.c_str(), "wb");
+	if (file == NULL)
+		return false;
+
+	unsigned long long offset = 0;
+	bool ok = writePadded(file, &header, sizeof(header), offset)
+		&& writePadded(file, vbo.empty() ? nullptr : &vbo[0], vbo.size() * sizeof(float), offset)
+		&& writePadded(file, mesh.gpuVertices.empty() ? nullptr : &mesh.gpuVertices[0], mesh.gpuVertices.size(), offset)
+		&& writePadded(file, ebo.data(), ebo.byteSize(), offset)
+		&& writePadded(file, ebo.chunks.empty() ? nullptr : &ebo.chunks[0], ebo.chunks.size() * sizeof(IndexChunk), offset)
+		&& writePadded(file, mesh.lods.empty() ? nullptr : &mesh.lods[0], mesh.lods.size() * sizeof(MeshLOD), offset);
+	ok = fclose(file) == 0 && ok;
+
+	if (ok) {
+		remove(cachePath.c_str());
+		ok = rename(tempPath.c_str(), cachePath.c_str()) == 0;
+	}
+	if (!ok)
+		remove(tempPath.c_str());
+	return ok;
+}
+
+static MeshBounds computeBounds(const std::vector<float>& vbo) {
+	MeshBounds bounds;
+	if (vbo.empty())
+		return bounds;
+	bounds.min = bounds.max = glm::vec3(vbo[0], vbo[1], vbo[2]);
+	for (size_t i = 0; i < vbo.size(); i += VERTEX_SIZE) {
+		glm::vec3 position(vbo[i], vbo[i + 1], vbo[i + 2]);
+		bounds.min = glm::min(bounds.min, position);
+		bounds.max = glm::max(bounds.max, position);
+	}
+	return bounds;
+}
+
+// Runs after indexing and before splitting, since splitting keeps triangle order.
+// Every LOD is cache optimized on its own; vertex fetch goes last so vertices follow LOD 0's final triangle order.
+static void processIndices(const char* objPath, const MeshImportSettings& settings, bool willSplit, ImportedMesh& mesh) {
+	std::vector<unsigned int> indices;
+	mesh.ebo.widen(indices);
+	size_t vertexCount = mesh.vbo.size() / VERTEX_SIZE;
+
+	VertexCacheStats before = analyzeVertexCache(indices, vertexCount);
+	if (settings.optimizeVertexCache) {
+		optimizeVertexCache(indices, vertexCount);
+		if (settings.optimizeOverdraw)
+			optimizeOverdraw(indices, mesh.vbo, VERTEX_SIZE);
+	}
+
+	// LODs are ranges of one index buffer over the shared vertices, which chunks can't express
+	mesh.lods.assign(1, MeshLOD());
+	mesh.lods[0].indexCount = (unsigned int)indices.size();
+	const size_t fullIndexCount = indices.size();
+	while (!willSplit && mesh.lods.size() < settings.lodCount) {
+		const MeshLOD& previous = mesh.lods.back();
+		size_t target = (size_t)(previous.indexCount * settings.lodReduction) / 3 * 3;
+		if (target < 3)
+			break;
+
+		std::vector<unsigned int> lodIndices(indices.begin(), indices.begin() + fullIndexCount);
+		float error = simplifyMesh(lodIndices, mesh.vbo, VERTEX_SIZE, target, lodIndices);
+		// stop once the simplifier is stuck on locked borders or flips
+		if (lodIndices.empty() || lodIndices.size() > previous.indexCount * 9 / 10)
+			break;
+		if (settings.optimizeVertexCache)
+			optimizeVertexCache(lodIndices, vertexCount);
+
+		MeshLOD lod;
+		lod.firstIndex = (unsigned int)indices.size();
+		lod.indexCount = (unsigned int)lodIndices.size();
+		lod.error = std::max(error, previous.error);
+		mesh.lods.push_back(lod);
+		indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+	}
+
+	if (settings.optimizeVertexCache)
+		optimizeVertexFetch(indices, mesh.vbo, VERTEX_SIZE);
+	vertexCount = mesh.vbo.size() / VERTEX_SIZE;
+	mesh.ebo.assign(indices, vertexCount);
+
+	if (settings.optimizeVertexCache) {
+		std::vector<unsigned int> lod0(indices.begin(), indices.begin() + fullIndexCount);
+		VertexCacheStats after = analyzeVertexCache(lod0, vertexCount);
+		printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", objPath, before.acmr, after.acmr, before.atvr, after.atvr);
+	}
+	for (size_t i = 1; i < mesh.lods.size(); i++)
+		printf("%s: LOD %zu %u triangles, error %g\n", objPath, i, mesh.lods[i].indexCount / 3, mesh.lods[i].error);
+}
+
+unsigned int selectMeshLOD(const ImportedMesh& mesh, float distance, float pixelsPerUnit, float maxPixelError) {
+	// an error of e model units at distance d covers about e / d * pixelsPerUnit pixels
+	distance = std::max(distance, 1e-4f);
+	unsigned int selected = 0;
+	for (unsigned int i = 1; i < mesh.lods.size(); i++) {
+		if (mesh.lods[i].error / distance * pixelsPerUnit > maxPixelError)
+			break;
+		selected = i;
+	}
+	return selected;
+}
+
+bool importMesh(const char* objPath, const MeshImportSettings& settings, ImportedMesh& out_mesh, JobSystem* jobs) {
+
+	MappedFile source;
+	if (!source.Open(objPath)) {
+		printf("Couldn't open file %s\n", objPath);
+		return false;
+	}
+	unsigned long long key = importKey(source, settings);
+	source.Close();
+
+	VertexLayout layout = VertexLayout::Get(settings.layout);
+	std::string cachePath = cachePathFor(objPath, settings);
+	if (loadBakedMesh(cachePath, key, layout, out_mesh))
+		return true;
+
+	std::vector<float> rawVertexData;
+	if (!loadOBJ(objPath, rawVertexData, nullptr, jobs))
+		return false;
+
+	out_mesh.vbo.clear();
+	indexVBO(rawVertexData, out_mesh.ebo, out_mesh.vbo, VERTEX_SIZE);
+	bool willSplit = settings.splitLargeMeshes && out_mesh.vbo.size() / VERTEX_SIZE > 65536;
+	processIndices(objPath, settings, willSplit, out_mesh);
+	if (willSplit)
+		splitIndexBuffer(out_mesh.vbo, out_mesh.ebo, VERTEX_SIZE);
+
+	out_mesh.bounds = computeBounds(out_mesh.vbo);
+	packVertices(out_mesh.vbo, VERTEX_SIZE, layout, out_mesh.bounds.min, out_mesh.bounds.max, settings.color, out_mesh.gpuVertices);
+
+	if (!bakeMesh(cachePath, key, layout, out_mesh))
+		std::cout << "Couldn't write mesh cache " << cachePath << std::endl;
+	return true;
+}
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <cmath>
+#include <glm.hpp>
+
+#include "headers/MeshOptimizer.hpp"
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize) {
+	VertexCacheStats stats;
+	if (indices.empty() || vertexCount == 0)
+		return stats;
+
+	// cacheTime[v] is the miss count when v entered the cache; it's still cached while fewer than cacheSize misses followed
+	std::vector<size_t> cacheTime(vertexCount, 0);
+	size_t misses = 0;
+	for (unsigned int v : indices) {
+		if (cacheTime[v] == 0 || misses - cacheTime[v] >= cacheSize) {
+			misses++;
+			cacheTime[v] = misses;
+		}
+	}
+
+	stats.acmr = (float)misses / (float)(indices.size() / 3);
+	stats.atvr = (float)misses / (float)vertexCount;
+	return stats;
+}
+
+// Forsyth's scoring constants, tuned for a 32 entry LRU cache.
+static const int FORSYTH_CACHE_SIZE = 32;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static const float FORSYTH_VALENCE_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_POWER = 0.5f;
+
+static float forsythVertexScore(int cachePosition, unsigned int remainingTriangles) {
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			// the last triangle's vertices get a fixed score so its neighbours aren't picked for free
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		}
+		else {
+			float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = powf(1.0f - (cachePosition - 3) * scale, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+	// favour vertices with few triangles left, so they leave the working set early
+	score += FORSYTH_VALENCE_SCALE * powf((float)remainingTriangles, -FORSYTH_VALENCE_POWER);
+	return score;
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// vertex -> triangles adjacency, as offsets into one array
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (unsigned int v : indices)
+		remaining[v]++;
+
+	std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int k = 0; k < 3; k++)
+			adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+	}
+
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<unsigned int> cache;
+	std::vector<unsigned int> newCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+
+	size_t scanCursor = 0; // for restarting when nothing in the cache has triangles left
+	long long best = -1;
+	float bestScore = -1.0f;
+	for (size_t t = 0; t < triangleCount; t++) {
+		if (triangleScore[t] > bestScore) {
+			bestScore = triangleScore[t];
+			best = (long long)t;
+		}
+	}
+
+	while (best >= 0) {
+		size_t triangle = (size_t)best;
+		emitted[triangle] = true;
+		const unsigned int* corners = &indices[triangle * 3];
+		result.insert(result.end(), corners, corners + 3);
+
+		// push the triangle's vertices to the front of the LRU cache
+		newCache.clear();
+		for (int k = 0; k < 3; k++) {
+			newCache.push_back(corners[k]);
+
+			// take the triangle out of the vertex's remaining adjacency
+			unsigned int v = corners[k];
+			unsigned int* begin = &adjacency[adjacencyOffset[v]];
+			unsigned int* end = begin + remaining[v];
+			std::iter_swap(std::find(begin, end, (unsigned int)triangle), end - 1);
+			remaining[v]--;
+		}
+		for (unsigned int v : cache) {
+			if (v != corners[0] && v != corners[1] && v != corners[2])
+				newCache.push_back(v);
+		}
+
+		// rescore everything that moved in the cache, including what fell out
+		for (size_t i = 0; i < newCache.size(); i++) {
+			unsigned int v = newCache[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? (int)i : -1;
+			vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v]);
+		}
+		if (newCache.size() > FORSYTH_CACHE_SIZE)
+			newCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(newCache);
+
+		// only triangles touching the cache changed score, so the next best is among them
+		best = -1;
+		bestScore = -1.0f;
+		for (unsigned int v : cache) {
+			for (unsigned int a = 0; a < remaining[v]; a++) {
+				unsigned int t = adjacency[adjacencyOffset[v] + a];
+				float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				triangleScore[t] = score;
+				if (score > bestScore) {
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+
+		if (best < 0) {
+			while (scanCursor < triangleCount && emitted[scanCursor])
+				scanCursor++;
+			if (scanCursor < triangleCount)
+				best = (long long)scanCursor;
+		}
+	}
+
+	indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vbo, int vertex_size, float threshold) {
+	const size_t triangleCount = indices.size() / 3;
+	const size_t vertexCount = vbo.size() / vertex_size;
+	if (triangleCount == 0)
+		return;
+
+	const unsigned int cacheSize = 16;
+	std::vector<size_t> cacheTime(vertexCount, 0);
+	size_t time = 0;   // total misses, never rewinds
+	size_t misses = 0; // misses since the last reset
+	auto resetCache = [&]() {
+		// skipping a whole cache's worth of time evicts everything without touching cacheTime
+		time += cacheSize;
+		misses = 0;
+	};
+	auto simulate = [&](size_t triangle) {
+		unsigned int triangleMisses = 0;
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = indices[triangle * 3 + k];
+			if (cacheTime[v] == 0 || time - cacheTime[v] >= cacheSize) {
+				time++;
+				misses++;
+				cacheTime[v] = time;
+				triangleMisses++;
+			}
+		}
+		return triangleMisses;
+	};
+
+	// hard boundaries: triangles that miss on all three vertices, where the cache starts over anyway
+	std::vector<size_t> hardClusters;
+	for (size_t t = 0; t < triangleCount; t++) {
+		if (simulate(t) == 3)
+			hardClusters.push_back(t);
+	}
+	hardClusters.push_back(triangleCount);
+
+	// soft boundaries: split a hard cluster as soon as its running ACMR is within threshold of the whole cluster's
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hardClusters.size(); h++) {
+		size_t start = hardClusters[h];
+		size_t end = hardClusters[h + 1];
+
+		resetCache();
+		for (size_t t = start; t < end; t++)
+			simulate(t);
+		float clusterThreshold = threshold * (float)misses / (float)(end - start);
+
+		resetCache();
+		size_t clusterStart = start;
+		clusters.push_back(start);
+		for (size_t t = start; t < end; t++) {
+			simulate(t);
+			if (t + 1 < end && (float)misses / (float)(t + 1 - clusterStart) <= clusterThreshold) {
+				clusters.push_back(t + 1);
+				clusterStart = t + 1;
+				resetCache();
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	auto position = [&](unsigned int v) {
+		return glm::vec3(vbo[v * vertex_size], vbo[v * vertex_size + 1], vbo[v * vertex_size + 2]);
+	};
+
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	for (size_t t = 0; t < triangleCount; t++) {
+		glm::vec3 a = position(indices[t * 3]), b = position(indices[t * 3 + 1]), c = position(indices[t * 3 + 2]);
+		float area = glm::length(glm::cross(b - a, c - a));
+		meshCenter += (a + b + c) * (area / 3.0f);
+		meshArea += area;
+	}
+	meshCenter = meshArea > 0.0f ? meshCenter / meshArea : meshCenter;
+
+	struct ClusterSort {
+		size_t start;
+		size_t end;
+		float key;
+	};
+	std::vector<ClusterSort> sorted;
+	for (size_t c = 0; c + 1 < clusters.size(); c++) {
+		glm::vec3 center(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+			glm::vec3 a = position(indices[t * 3]), b = position(indices[t * 3 + 1]), d = position(indices[t * 3 + 2]);
+			glm::vec3 n = glm::cross(b - a, d - a);
+			float triangleArea = glm::length(n);
+			center += (a + b + d) * (triangleArea / 3.0f);
+			normal += n;
+			area += triangleArea;
+		}
+		center = area > 0.0f ? center / area : center;
+		float normalLength = glm::length(normal);
+		normal = normalLength > 0.0f ? normal / normalLength : normal;
+		sorted.push_back({ clusters[c], clusters[c + 1], glm::dot(center - meshCenter, normal) });
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(), [](const ClusterSort& a, const ClusterSort& b) { return a.key > b.key; });
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	for (const ClusterSort& cluster : sorted)
+		result.insert(result.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+	indices.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<unsigned int>& indices, std::vector<float>& vbo, int vertex_size) {
+	const unsigned int UNMAPPED = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(vbo.size() / vertex_size, UNMAPPED);
+	std::vector<float> result;
+	result.reserve(vbo.size());
+
+	for (unsigned int& v : indices) {
+		if (remap[v] == UNMAPPED) {
+			remap[v] = (unsigned int)(result.size() / vertex_size);
+			result.insert(result.end(), &vbo[v * vertex_size], &vbo[v * vertex_size] + vertex_size);
+		}
+		v = remap[v];
+	}
+	vbo.swap(result);
+}
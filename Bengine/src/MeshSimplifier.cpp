@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <unordered_map>
+#include <glm.hpp>
+
+#include "headers/MeshSimplifier.hpp"
+
+// Symmetric 4x4 error quadric, stored as its 10 unique coefficients.
+struct Quadric {
+	double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+	double b0 = 0, b1 = 0, b2 = 0;
+	double c = 0;
+
+	void addPlane(const glm::dvec3& n, double d) {
+		a00 += n.x * n.x; a01 += n.x * n.y; a02 += n.x * n.z;
+		a11 += n.y * n.y; a12 += n.y * n.z; a22 += n.z * n.z;
+		b0 += n.x * d; b1 += n.y * d; b2 += n.z * d;
+		c += d * d;
+	}
+
+	void add(const Quadric& q) {
+		a00 += q.a00; a01 += q.a01; a02 += q.a02;
+		a11 += q.a11; a12 += q.a12; a22 += q.a22;
+		b0 += q.b0; b1 += q.b1; b2 += q.b2;
+		c += q.c;
+	}
+
+	// sum of squared distances from p to every plane added
+	double error(const glm::dvec3& p) const {
+		double r = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+			+ 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+			+ 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z)
+			+ c;
+		return r > 0.0 ? r : 0.0;
+	}
+};
+
+struct Collapse {
+	unsigned int from;
+	unsigned int to;
+	double cost;
+};
+
+static glm::dvec3 triangleNormal(const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c) {
+	return glm::cross(b - a, c - a);
+}
+
+float simplifyMesh(
+	const std::vector<unsigned int>& indices,
+	const std::vector<float>& vbo,
+	int vertex_size,
+	size_t targetIndexCount,
+	std::vector<unsigned int>& out_indices) {
+
+	const size_t vertexCount = vbo.size() / vertex_size;
+
+	// Vertices that differ only in normal are separate in the vbo but must collapse together,
+	// or the LOD tears along every seam. Simplify over unique positions instead.
+	std::vector<unsigned int> positionOf(vertexCount);
+	std::vector<unsigned int> wedgeOf; // position -> a vertex with that position
+	std::vector<glm::dvec3> positions;
+	{
+		struct PositionHash {
+			size_t operator()(const glm::vec3& p) const {
+				unsigned int bits[3];
+				memcpy(bits, &p, sizeof(bits));
+				return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+			}
+		};
+		std::unordered_map<glm::vec3, unsigned int, PositionHash> unique;
+		unique.reserve(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) {
+			glm::vec3 p(vbo[v * vertex_size], vbo[v * vertex_size + 1], vbo[v * vertex_size + 2]);
+			auto found = unique.emplace(p, (unsigned int)positions.size());
+			if (found.second) {
+				positions.push_back(glm::dvec3(p));
+				wedgeOf.push_back((unsigned int)v);
+			}
+			positionOf[v] = found.first->second;
+		}
+	}
+	const size_t positionCount = positions.size();
+
+	// each corner keeps its own vertex for as long as its position survives
+	std::vector<unsigned int> corners(indices);
+	std::vector<unsigned int> triangles(indices.size());
+	for (size_t i = 0; i < indices.size(); i++)
+		triangles[i] = positionOf[indices[i]];
+
+	std::vector<Quadric> quadrics(positionCount);
+	for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+		const glm::dvec3& a = positions[triangles[i]];
+		glm::dvec3 n = triangleNormal(a, positions[triangles[i + 1]], positions[triangles[i + 2]]);
+		double length = glm::length(n);
+		if (length == 0.0)
+			continue;
+		n /= length;
+		double d = -glm::dot(n, a);
+		for (int k = 0; k < 3; k++)
+			quadrics[triangles[i + k]].addPlane(n, d);
+	}
+
+	// lock vertices on open borders: an edge used by one triangle only
+	std::vector<bool> locked(positionCount, false);
+	{
+		std::unordered_map<unsigned long long, unsigned int> edgeUses;
+		edgeUses.reserve(triangles.size());
+		for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				unsigned int a = triangles[i + k], b = triangles[i + (k + 1) % 3];
+				unsigned long long key = a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+				edgeUses[key]++;
+			}
+		}
+		for (const auto& edge : edgeUses) {
+			if (edge.second == 1) {
+				locked[(unsigned int)(edge.first >> 32)] = true;
+				locked[(unsigned int)(edge.first & 0xFFFFFFFF)] = true;
+			}
+		}
+	}
+
+	double maxCost = 0.0;
+	std::vector<unsigned int> remap(positionCount);
+	std::vector<bool> touched(positionCount);
+	std::vector<unsigned int> adjacencyOffset(positionCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<Collapse> collapses;
+
+	// Each pass collapses an independent set of the cheapest edges, then rebuilds the triangle list.
+	while (triangles.size() > targetIndexCount) {
+		const size_t triangleCount = triangles.size() / 3;
+
+		// position -> triangles touching it
+		std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+		for (unsigned int p : triangles)
+			adjacencyOffset[p + 1]++;
+		for (size_t p = 0; p < positionCount; p++)
+			adjacencyOffset[p + 1] += adjacencyOffset[p];
+		adjacency.resize(triangles.size());
+		{
+			std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+			for (size_t t = 0; t < triangleCount; t++) {
+				for (int k = 0; k < 3; k++)
+					adjacency[fill[triangles[t * 3 + k]]++] = (unsigned int)t;
+			}
+		}
+
+		collapses.clear();
+		for (size_t t = 0; t < triangleCount; t++) {
+			for (int k = 0; k < 3; k++) {
+				unsigned int a = triangles[t * 3 + k], b = triangles[t * 3 + (k + 1) % 3];
+				if (a > b)
+					continue; // every interior edge shows up once in each direction
+				Quadric q = quadrics[a];
+				q.add(quadrics[b]);
+				double toB = locked[a] ? HUGE_VAL : q.error(positions[b]);
+				double toA = locked[b] ? HUGE_VAL : q.error(positions[a]);
+				if (toB == HUGE_VAL && toA == HUGE_VAL)
+					continue;
+				if (toB <= toA)
+					collapses.push_back({ a, b, toB });
+				else
+					collapses.push_back({ b, a, toA });
+			}
+		}
+		if (collapses.empty())
+			break;
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		for (size_t p = 0; p < positionCount; p++)
+			remap[p] = (unsigned int)p;
+		std::fill(touched.begin(), touched.end(), false);
+
+		// every collapse removes about two triangles
+		size_t trianglesToRemove = (triangles.size() - targetIndexCount) / 3;
+		size_t removed = 0;
+		for (const Collapse& collapse : collapses) {
+			if (removed >= trianglesToRemove)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			// reject collapses that would flip a triangle around the vertex being moved
+			bool flips = false;
+			for (unsigned int a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1] && !flips; a++) {
+				const unsigned int* tri = &triangles[adjacency[a] * 3];
+				if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+					continue;
+				glm::dvec3 before[3], after[3];
+				for (int k = 0; k < 3; k++) {
+					before[k] = positions[tri[k]];
+					after[k] = tri[k] == collapse.from ? positions[collapse.to] : before[k];
+				}
+				glm::dvec3 n0 = triangleNormal(before[0], before[1], before[2]);
+				glm::dvec3 n1 = triangleNormal(after[0], after[1], after[2]);
+				flips = glm::dot(n0, n1) <= 0.0;
+			}
+			if (flips)
+				continue;
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			maxCost = std::max(maxCost, collapse.cost);
+
+			// freeze the whole one-ring, since its triangles are about to change
+			for (unsigned int a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1]; a++) {
+				const unsigned int* tri = &triangles[adjacency[a] * 3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+				if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+					removed++;
+			}
+		}
+		if (removed == 0)
+			break;
+
+		// apply the pass and drop triangles that collapsed to a line
+		size_t write = 0;
+		for (size_t t = 0; t < triangleCount; t++) {
+			unsigned int p[3], c[3];
+			for (int k = 0; k < 3; k++) {
+				p[k] = remap[triangles[t * 3 + k]];
+				c[k] = p[k] == triangles[t * 3 + k] ? corners[t * 3 + k] : wedgeOf[p[k]];
+			}
+			if (p[0] == p[1] || p[1] == p[2] || p[0] == p[2])
+				continue;
+			for (int k = 0; k < 3; k++) {
+				triangles[write + k] = p[k];
+				corners[write + k] = c[k];
+			}
+			write += 3;
+		}
+		triangles.resize(write);
+		corners.resize(write);
+	}
+
+	out_indices.swap(corners);
+	return (float)sqrt(maxCost);
+}
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cmath>
+#include <xmmintrin.h>
+
+#include "headers/OcclusionBuffer.hpp"
+
+static const int TILE_SIZE = 8;
+static const float NEAR_W = 1e-4f; // vertices closer than this to the eye plane don't project
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+	: width((width + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE),
+	height((height + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE) {
+	tilesX = this->width / TILE_SIZE;
+	tilesY = this->height / TILE_SIZE;
+	depth.resize(this->width * this->height);
+	tileMaxDepth.resize(tilesX * tilesY);
+	Clear();
+}
+
+void OcclusionBuffer::Clear() {
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	std::fill(tileMaxDepth.begin(), tileMaxDepth.end(), 1.0f);
+}
+
+void OcclusionBuffer::RasterizeOccluder(const float* vertices, int vertexStride, const IndexBuffer& indices,
+	unsigned int firstIndex, unsigned int indexCount, int baseVertex, const glm::mat4& mvp) {
+
+	for (unsigned int i = firstIndex; i + 2 < firstIndex + indexCount; i += 3) {
+		glm::vec4 clip[3];
+		bool crossesNear = false;
+		for (int k = 0; k < 3; k++) {
+			const float* v = &vertices[(baseVertex + indices[i + k]) * vertexStride];
+			clip[k] = mvp * glm::vec4(v[0], v[1], v[2], 1.0f);
+			crossesNear = crossesNear || clip[k].w < NEAR_W || clip[k].z < -clip[k].w;
+		}
+		// clipping would only add occlusion, so triangles through the near plane are dropped instead
+		if (crossesNear)
+			continue;
+		RasterizeTriangle(clip[0], clip[1], clip[2]);
+	}
+}
+
+void OcclusionBuffer::RasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+	// screen space with y up, so counter clockwise front faces keep a positive area
+	glm::vec3 s[3];
+	const glm::vec4* clip[3] = { &a, &b, &c };
+	for (int k = 0; k < 3; k++) {
+		float invW = 1.0f / clip[k]->w;
+		s[k] = glm::vec3((clip[k]->x * invW * 0.5f + 0.5f) * width, (clip[k]->y * invW * 0.5f + 0.5f) * height, clip[k]->z * invW * 0.5f + 0.5f);
+	}
+
+	float area = (s[1].x - s[0].x) * (s[2].y - s[0].y) - (s[2].x - s[0].x) * (s[1].y - s[0].y);
+	if (area <= 0.0f)
+		return;
+
+	// pixel range whose centers can be inside
+	int minX = std::max(0, (int)std::ceil(std::min(std::min(s[0].x, s[1].x), s[2].x) - 0.5f));
+	int maxX = std::min(width - 1, (int)std::floor(std::max(std::max(s[0].x, s[1].x), s[2].x) - 0.5f));
+	int minY = std::max(0, (int)std::ceil(std::min(std::min(s[0].y, s[1].y), s[2].y) - 0.5f));
+	int maxY = std::min(height - 1, (int)std::floor(std::max(std::max(s[0].y, s[1].y), s[2].y) - 0.5f));
+	if (minX > maxX || minY > maxY)
+		return;
+	stats.occluderTriangles++;
+
+	// edge k is inside when edgeA * x + edgeB * y + edgeC >= 0; depth is a plane in screen space
+	float edgeA[3], edgeB[3], edgeC[3];
+	for (int k = 0; k < 3; k++) {
+		const glm::vec3& p = s[k];
+		const glm::vec3& q = s[(k + 1) % 3];
+		edgeA[k] = p.y - q.y;
+		edgeB[k] = q.x - p.x;
+		edgeC[k] = p.x * q.y - p.y * q.x;
+	}
+	// the edge opposite vertex k weights vertex k
+	float invArea = 1.0f / area;
+	float depthA = (edgeA[1] * s[0].z + edgeA[2] * s[1].z + edgeA[0] * s[2].z) * invArea;
+	float depthB = (edgeB[1] * s[0].z + edgeB[2] * s[1].z + edgeB[0] * s[2].z) * invArea;
+	float depthC = (edgeC[1] * s[0].z + edgeC[2] * s[1].z + edgeC[0] * s[2].z) * invArea;
+
+	const int startX = minX & ~3;
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 lastX = _mm_set1_ps((float)maxX + 0.5f);
+	const __m128 firstX = _mm_set1_ps((float)minX + 0.5f);
+
+	for (int y = minY; y <= maxY; y++) {
+		float py = (float)y + 0.5f;
+		float* row = &depth[y * width];
+		for (int x = startX; x <= maxX; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(px, firstX), _mm_cmple_ps(px, lastX));
+			for (int k = 0; k < 3; k++) {
+				__m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edgeA[k]), px), _mm_set1_ps(edgeB[k] * py + edgeC[k]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+			}
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depthA), px), _mm_set1_ps(depthB * py + depthC));
+			__m128 current = _mm_loadu_ps(&row[x]);
+			__m128 nearer = _mm_min_ps(current, z);
+			_mm_storeu_ps(&row[x], _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+		}
+	}
+}
+
+void OcclusionBuffer::UpdateHierarchy() {
+	for (int ty = 0; ty < tilesY; ty++) {
+		for (int tx = 0; tx < tilesX; tx++) {
+			__m128 farthest = _mm_setzero_ps();
+			for (int y = ty * TILE_SIZE; y < (ty + 1) * TILE_SIZE; y++) {
+				const float* row = &depth[y * width + tx * TILE_SIZE];
+				for (int x = 0; x < TILE_SIZE; x += 4)
+					farthest = _mm_max_ps(farthest, _mm_loadu_ps(&row[x]));
+			}
+			float lanes[4];
+			_mm_storeu_ps(lanes, farthest);
+			tileMaxDepth[ty * tilesX + tx] = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+		}
+	}
+}
+
+bool OcclusionBuffer::IsVisible(const glm::vec3& min, const glm::vec3& max, const glm::mat4& viewProj) {
+	stats.tested++;
+
+	// screen rectangle and nearest depth of the box's corners
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1.0f;
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec4 clip = viewProj * glm::vec4(corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y, corner & 4 ? max.z : min.z, 1.0f);
+		if (clip.w < NEAR_W || clip.z < -clip.w)
+			return true; // reaches through the near plane, so it could cover anything
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * width;
+		float y = (clip.y * invW * 0.5f + 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z * invW * 0.5f + 0.5f);
+	}
+
+	// every pixel the rectangle touches, not just covered centers
+	int x0 = std::max(0, (int)std::floor(minX));
+	int x1 = std::min(width - 1, (int)std::floor(maxX));
+	int y0 = std::max(0, (int)std::floor(minY));
+	int y1 = std::min(height - 1, (int)std::floor(maxY));
+	if (x0 > x1 || y0 > y1)
+		return true; // off screen; leave that to the frustum culler
+
+	const __m128 boxDepth = _mm_set1_ps(nearest);
+	for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ty++) {
+		for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; tx++) {
+			// everything in the tile is nearer than the box
+			if (nearest > tileMaxDepth[ty * tilesX + tx])
+				continue;
+
+			int px0 = std::max(x0, tx * TILE_SIZE), px1 = std::min(x1, tx * TILE_SIZE + TILE_SIZE - 1);
+			int py0 = std::max(y0, ty * TILE_SIZE), py1 = std::min(y1, ty * TILE_SIZE + TILE_SIZE - 1);
+			for (int y = py0; y <= py1; y++) {
+				const float* row = &depth[y * width];
+				for (int x = px0 & ~3; x <= px1; x += 4) {
+					__m128 lane = _mm_add_ps(_mm_set1_ps((float)x), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+					__m128 inRect = _mm_and_ps(_mm_cmpge_ps(lane, _mm_set1_ps((float)px0)), _mm_cmple_ps(lane, _mm_set1_ps((float)px1)));
+					__m128 open = _mm_cmpge_ps(_mm_loadu_ps(&row[x]), boxDepth);
+					if (_mm_movemask_ps(_mm_and_ps(inRect, open)))
+						return true;
+				}
+			}
+		}
+	}
+
+	stats.occluded++;
+	return false;
+}
@@ -0,0 +1,72 @@
+#include "headers/PhysicsBodies.hpp"
+#include "headers/FrustumCuller.hpp"
+#include "headers/SimulationThread.hpp"
+
+btRigidBody* createPhysicsBody(PhysicsPools& pools, Entity entity, const btTransform& transform, btScalar mass,
+	btCollisionShape* shape, btDiscreteDynamicsWorld* world) {
+
+	//rigidbody is dynamic if and only if mass is non zero, otherwise static
+	btVector3 localInertia(0, 0, 0);
+	if (mass != 0.f)
+		shape->calculateLocalInertia(mass, localInertia);
+
+	//using motionstate is optional, it provides interpolation capabilities, and only synchronizes 'active' objects
+	PhysicsBody physicsBody;
+	physicsBody.motionState = pools.motionStates.Create(transform);
+	btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, pools.motionStates.Get(physicsBody.motionState), shape, localInertia);
+	physicsBody.body = pools.rigidBodies.Create(rbInfo);
+	btRigidBody* body = pools.rigidBodies.Get(physicsBody.body);
+
+	//the body carries its entity's id, which is how the simulation's snapshots find the entity's transform
+	body->setUserIndex((int)entity.id);
+
+	world->addRigidBody(body);
+	pools.bodies.Add(entity, physicsBody);
+	return body;
+}
+
+void destroyPhysicsBody(PhysicsPools& pools, Entity entity, btDiscreteDynamicsWorld* world) {
+	PhysicsBody* physicsBody = pools.bodies.Find(entity);
+	if (!physicsBody)
+		return;
+	btRigidBody* body = pools.rigidBodies.Get(physicsBody->body);
+
+	// a body only lists its constraints when they were added with collisions between the bodies disabled,
+	// so look through the world's; every constraint came from the pool
+	for (int i = world->getNumConstraints() - 1; i >= 0; i--) {
+		btTypedConstraint* constraint = world->getConstraint(i);
+		if (&constraint->getRigidBodyA() != body && &constraint->getRigidBodyB() != body)
+			continue;
+		world->removeConstraint(constraint);
+		pools.constraints.Destroy(pools.constraints.HandleOf(static_cast<btGeneric6DofConstraint*>(constraint)));
+	}
+
+	world->removeRigidBody(body);
+	pools.rigidBodies.Destroy(physicsBody->body);
+	pools.motionStates.Destroy(physicsBody->motionState);
+	pools.bodies.Remove(entity);
+}
+
+void spawnPhysicsBody(Scene& scene, SimulationThread& simulation, PhysicsPools& pools, Entity entity,
+	const btTransform& transform, btScalar mass, btCollisionShape* shape) {
+	scene.transforms.Add(entity, transform);
+	RenderMesh* mesh = scene.renderMeshes.Find(entity);
+	if (mesh)
+		mesh->isStatic = mass == 0.f;
+	simulation.Enqueue([&pools, entity, transform, mass, shape](btDiscreteDynamicsWorld* world) {
+		createPhysicsBody(pools, entity, transform, mass, shape, world);
+	});
+}
+
+void destroyEntity(Scene& scene, SimulationThread& simulation, PhysicsPools& pools, Entity entity,
+	FrustumCuller* culler) {
+	if (!scene.IsAlive(entity))
+		return;
+	if (culler)
+		culler->Remove(entity.Index());
+	// the scene can't tell whether the entity has a body, since the pools aren't the render thread's to read
+	simulation.Enqueue([&pools, entity](btDiscreteDynamicsWorld* world) {
+		destroyPhysicsBody(pools, entity, world);
+	});
+	scene.Destroy(entity);
+}
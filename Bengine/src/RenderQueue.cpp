@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <string.h>
+
+#include "headers/RenderQueue.hpp"
+
+static const size_t EXTRACT_BATCH_SIZE = 256;
+
+unsigned long long RenderKey::Make(unsigned int pass, unsigned int program, unsigned int asset, unsigned int lod, float depth) {
+	depth = std::min(std::max(depth, 0.0f), 1.0f);
+	unsigned long long quantizedDepth = (unsigned long long)(depth * ((1u << DEPTH_BITS) - 1));
+	return ((unsigned long long)(pass & ((1u << PASS_BITS) - 1)) << PASS_SHIFT)
+		| ((unsigned long long)(program & ((1u << PROGRAM_BITS) - 1)) << PROGRAM_SHIFT)
+		| ((unsigned long long)(asset & ((1u << ASSET_BITS) - 1)) << ASSET_SHIFT)
+		| ((unsigned long long)(lod & ((1u << LOD_BITS) - 1)) << LOD_SHIFT)
+		| (quantizedDepth << DEPTH_SHIFT);
+}
+
+void RenderQueue::ExtractRange(size_t begin, size_t end, const Extractor& extract) {
+	for (size_t i = begin; i < end; i++) {
+		commands[i].key = extract(i, extracted[i]);
+		commands[i].object = (unsigned int)i;
+	}
+}
+
+void RenderQueue::Build(JobSystem& jobs, size_t objectCount, const Extractor& extract) {
+	// every object has its own slot, so workers never share an output and the result doesn't depend on scheduling
+	commands.resize(objectCount);
+	extracted.resize(objectCount);
+	jobs.ParallelFor(0, objectCount, EXTRACT_BATCH_SIZE, [this, &extract](size_t begin, size_t end) {
+		ExtractRange(begin, end, extract);
+	});
+}
+
+void RenderQueue::BuildSerial(size_t objectCount, const Extractor& extract) {
+	commands.resize(objectCount);
+	extracted.resize(objectCount);
+	ExtractRange(0, objectCount, extract);
+}
+
+void RenderQueue::Sort() {
+	// least significant digit first, 8 bits per pass. Each pass is stable, and passes
+	// whose digit is the same for every key are skipped, so short keys sort in few passes.
+	// All eight histograms come from one read of the keys.
+	size_t counts[8][256] = {};
+	for (const Command& command : commands) {
+		for (int digit = 0; digit < 8; digit++)
+			counts[digit][(command.key >> (digit * 8)) & 0xFF]++;
+	}
+
+	scratch.resize(commands.size());
+	for (int digit = 0; digit < 8 && !commands.empty(); digit++) {
+		const int shift = digit * 8;
+		if (counts[digit][(commands[0].key >> shift) & 0xFF] == commands.size())
+			continue;
+
+		size_t offsets[256];
+		size_t total = 0;
+		for (int value = 0; value < 256; value++) {
+			offsets[value] = total;
+			total += counts[digit][value];
+		}
+		for (const Command& command : commands)
+			scratch[offsets[(command.key >> shift) & 0xFF]++] = command;
+		commands.swap(scratch);
+	}
+
+	// invalid keys sort last
+	while (!commands.empty() && commands.back().key == RenderKey::INVALID)
+		commands.pop_back();
+
+	instances.clear();
+	groups.clear();
+	instances.reserve(commands.size());
+	const unsigned long long groupMask = ~((1ULL << RenderKey::LOD_SHIFT) - 1); // everything above depth
+	unsigned long long groupKey = 0;
+	for (const Command& command : commands) {
+		if (groups.empty() || (command.key & groupMask) != groupKey) {
+			groupKey = command.key & groupMask;
+			InstanceGroup group;
+			group.pass = RenderKey::Pass(command.key);
+			group.program = RenderKey::Program(command.key);
+			group.assetIndex = RenderKey::Asset(command.key);
+			group.lod = RenderKey::Lod(command.key);
+			group.firstInstance = (unsigned int)instances.size();
+			group.instanceCount = 0;
+			groups.push_back(group);
+		}
+		groups.back().instanceCount++;
+		instances.push_back(extracted[command.object]);
+	}
+}
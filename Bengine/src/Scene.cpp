@@ -0,0 +1,51 @@
+#include "headers/Scene.hpp"
+
+Entity Scene::Create(const char* name) {
+	unsigned int index;
+	if (!freeSlots.empty()) {
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else {
+		index = (unsigned int)generations.size();
+		generations.push_back(0);
+		alive.push_back(0);
+		names.push_back("");
+	}
+	alive[index] = 1;
+	names[index] = name;
+	aliveCount++;
+
+	Entity entity;
+	entity.id = (generations[index] << Entity::INDEX_BITS) | index;
+	return entity;
+}
+
+void Scene::Destroy(Entity entity) {
+	if (!IsAlive(entity))
+		return;
+	transforms.Remove(entity);
+	renderMeshes.Remove(entity);
+	materials.Remove(entity);
+
+	unsigned int index = entity.Index();
+	alive[index] = 0;
+	// the generation wraps within its bits; skip the one that would make the invalid id
+	generations[index] = (generations[index] + 1) & (0xFFFFFFFF >> Entity::INDEX_BITS);
+	if (((generations[index] << Entity::INDEX_BITS) | index) == Entity::INVALID_ID)
+		generations[index] = 0;
+	freeSlots.push_back(index);
+	aliveCount--;
+}
+
+bool Scene::IsAlive(Entity entity) const {
+	unsigned int index = entity.Index();
+	return entity.Valid() && index < generations.size() && alive[index] && generations[index] == entity.Generation();
+}
+
+Entity Scene::EntityAt(unsigned int index) const {
+	Entity entity;
+	if (index < generations.size() && alive[index])
+		entity.id = (generations[index] << Entity::INDEX_BITS) | index;
+	return entity;
+}
@@ -0,0 +1,275 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string.h>
+
+#include "headers/SelfTest.hpp"
+#include "headers/RenderQueue.hpp"
+#include "headers/JobSystem.hpp"
+#include "headers/Scene.hpp"
+#include "headers/PhysicsBodies.hpp"
+#include "headers/SimulationThread.hpp"
+
+static int failures = 0;
+
+// Counts and prints a failed check; passing ones stay quiet.
+static bool Check(bool condition, const char* what) {
+	if (!condition) {
+		failures++;
+		std::cout << "  FAILED: " << what << std::endl;
+	}
+	return condition;
+}
+
+/// <summary>
+/// Every field comes back out of the key it went into, out of range values are masked rather than spilling
+/// into the next field, and depth is clamped, quantized to the nearest step below and ordered.
+/// </summary>
+static void TestRenderKey() {
+	std::cout << "RenderKey" << std::endl;
+	const unsigned int maxPass = (1u << RenderKey::PASS_BITS) - 1;
+	const unsigned int maxProgram = (1u << RenderKey::PROGRAM_BITS) - 1;
+	const unsigned int maxAsset = (1u << RenderKey::ASSET_BITS) - 1;
+	const unsigned int maxLod = (1u << RenderKey::LOD_BITS) - 1;
+	const unsigned long long maxDepth = (1ULL << RenderKey::DEPTH_BITS) - 1;
+
+	Check(RenderKey::PASS_SHIFT + RenderKey::PASS_BITS < 64, "fields leave the top bit clear");
+
+	unsigned long long full = RenderKey::Make(maxPass, maxProgram, maxAsset, maxLod, 1.0f);
+	Check(RenderKey::Pass(full) == maxPass && RenderKey::Program(full) == maxProgram && RenderKey::Asset(full) == maxAsset
+		&& RenderKey::Lod(full) == maxLod, "largest value of every field round trips");
+	Check(full != RenderKey::INVALID, "a valid key never equals INVALID");
+
+	std::mt19937 random(99);
+	bool roundTrips = true;
+	for (int i = 0; i < 10000 && roundTrips; i++) {
+		unsigned int pass = random() & maxPass, program = random() & maxProgram, asset = random() & maxAsset, lod = random() & maxLod;
+		unsigned long long key = RenderKey::Make(pass, program, asset, lod, (float)(random() % 1000) / 1000.0f);
+		roundTrips = RenderKey::Pass(key) == pass && RenderKey::Program(key) == program && RenderKey::Asset(key) == asset
+			&& RenderKey::Lod(key) == lod;
+	}
+	Check(roundTrips, "random fields round trip");
+
+	unsigned long long overflowed = RenderKey::Make(maxPass + 2, maxProgram + 2, maxAsset + 2, maxLod + 2, 0.0f);
+	Check(RenderKey::Pass(overflowed) == 1 && RenderKey::Program(overflowed) == 1 && RenderKey::Asset(overflowed) == 1
+		&& RenderKey::Lod(overflowed) == 1, "out of range fields are masked to their width");
+	Check(RenderKey::Make(0, 0, maxAsset + 1, 0, 0.0f) == RenderKey::Make(0, 0, 0, 0, 0.0f), "an asset too large doesn't touch the program");
+
+	const unsigned long long depthMask = maxDepth << RenderKey::DEPTH_SHIFT;
+	Check((RenderKey::Make(0, 0, 0, 0, 0.0f) & depthMask) == 0, "depth 0 quantizes to 0");
+	Check((RenderKey::Make(0, 0, 0, 0, 1.0f) & depthMask) == depthMask, "depth 1 quantizes to the largest step");
+	Check((RenderKey::Make(0, 0, 0, 0, -5.0f) & depthMask) == 0, "negative depth clamps to 0");
+	Check((RenderKey::Make(0, 0, 0, 0, 5.0f) & depthMask) == depthMask, "depth past 1 clamps to the largest step");
+	Check((RenderKey::Make(maxPass, maxProgram, maxAsset, maxLod, 1.0f) & ~depthMask) == (full & ~depthMask), "depth stays in its own bits");
+
+	bool ordered = true, close = true;
+	unsigned long long previous = 0;
+	for (int i = 0; i <= 4096; i++) {
+		float depth = (float)i / 4096.0f;
+		unsigned long long quantized = (RenderKey::Make(0, 0, 0, 0, depth) & depthMask) >> RenderKey::DEPTH_SHIFT;
+		ordered = ordered && quantized >= previous;
+		close = close && fabs((double)quantized / maxDepth - depth) <= 1.0 / maxDepth;
+		previous = quantized;
+	}
+	Check(ordered, "farther depths never get smaller keys");
+	Check(close, "quantized depth is within one step of the input");
+
+	Check(RenderKey::Make(1, 0, 0, 0, 0.0f) > RenderKey::Make(0, maxProgram, maxAsset, maxLod, 1.0f), "pass outranks every other field");
+	Check(RenderKey::Make(0, 1, 0, 0, 0.0f) > RenderKey::Make(0, 0, maxAsset, maxLod, 1.0f), "program outranks asset, LOD and depth");
+	Check(RenderKey::Make(0, 0, 1, 0, 0.0f) > RenderKey::Make(0, 0, 0, maxLod, 1.0f), "asset outranks LOD and depth");
+	Check(RenderKey::Make(0, 0, 0, 1, 0.0f) > RenderKey::Make(0, 0, 0, 0, 1.0f), "LOD outranks depth");
+}
+
+/// <summary>
+/// Builds queues over random objects in both ways, sorts them and checks the order against std::sort,
+/// the groups against the sorted keys and each instance against the object it came from.
+/// </summary>
+static void TestRenderQueue() {
+	std::cout << "RenderQueue" << std::endl;
+	JobSystem jobs;
+	const size_t counts[] = { 0, 1, 255, 256, 257, 5000, 100000 };
+	for (size_t objectCount : counts) {
+		std::mt19937 random((unsigned int)objectCount);
+		std::vector<unsigned long long> keys(objectCount);
+		for (size_t i = 0; i < objectCount; i++) {
+			if (random() % 7 == 0)
+				keys[i] = RenderKey::INVALID;
+			else // few distinct passes, programs and LODs so groups hold more than one instance
+				keys[i] = RenderKey::Make(random() % 2, random() % 3, random() % 50, random() % 4, (float)(random() % 10000) / 10000.0f);
+		}
+		// the instance records which object it came from, in its color
+		auto extract = [&keys](size_t i, InstanceData& out_instance) -> unsigned long long {
+			memset(&out_instance, 0, sizeof(out_instance));
+			out_instance.color = glm::vec4((float)i, 0.0f, 0.0f, 1.0f);
+			return keys[i];
+		};
+
+		RenderQueue serial, parallel;
+		serial.BuildSerial(objectCount, extract);
+		parallel.Build(jobs, objectCount, extract);
+
+		bool builtAlike = serial.CommandCount() == parallel.CommandCount();
+		for (size_t i = 0; builtAlike && i < serial.CommandCount(); i++)
+			builtAlike = serial.Key(i) == parallel.Key(i);
+		Check(builtAlike, "Build and BuildSerial produce the same commands");
+
+		serial.Sort();
+		parallel.Sort();
+
+		bool sortedAlike = serial.CommandCount() == parallel.CommandCount()
+			&& serial.Groups().size() == parallel.Groups().size()
+			&& serial.Instances().size() == parallel.Instances().size();
+		for (size_t i = 0; sortedAlike && i < serial.CommandCount(); i++)
+			sortedAlike = serial.Key(i) == parallel.Key(i);
+		for (size_t i = 0; sortedAlike && i < serial.Instances().size(); i++)
+			sortedAlike = memcmp(&serial.Instances()[i], &parallel.Instances()[i], sizeof(InstanceData)) == 0;
+		Check(sortedAlike, "Build and BuildSerial sort to the same commands, groups and instances");
+
+		std::vector<unsigned long long> expected;
+		for (unsigned long long key : keys) {
+			if (key != RenderKey::INVALID)
+				expected.push_back(key);
+		}
+		std::sort(expected.begin(), expected.end());
+		bool matches = parallel.CommandCount() == expected.size();
+		for (size_t i = 0; matches && i < expected.size(); i++)
+			matches = parallel.Key(i) == expected[i];
+		Check(matches, "radix sort order matches std::sort and drops invalid keys");
+
+		const std::vector<InstanceGroup>& groups = parallel.Groups();
+		const std::vector<InstanceData>& instances = parallel.Instances();
+		bool contiguous = instances.size() == parallel.CommandCount();
+		bool keysMatch = true, distinct = true, instancesMatch = true;
+		unsigned int next = 0;
+		for (size_t g = 0; g < groups.size() && contiguous; g++) {
+			const InstanceGroup& group = groups[g];
+			contiguous = group.firstInstance == next && group.instanceCount > 0;
+			next += group.instanceCount;
+			for (unsigned int i = group.firstInstance; i < next && i < parallel.CommandCount(); i++) {
+				unsigned long long key = parallel.Key(i);
+				keysMatch = keysMatch && RenderKey::Pass(key) == group.pass && RenderKey::Program(key) == group.program
+					&& RenderKey::Asset(key) == group.assetIndex && RenderKey::Lod(key) == group.lod;
+				instancesMatch = instancesMatch && i < instances.size() && keys[(size_t)instances[i].color.x] == key;
+			}
+			if (g > 0) {
+				const InstanceGroup& before = groups[g - 1];
+				distinct = distinct && (before.pass != group.pass || before.program != group.program
+					|| before.assetIndex != group.assetIndex || before.lod != group.lod);
+			}
+		}
+		Check(contiguous && next == parallel.CommandCount(), "groups cover the sorted instances back to back");
+		Check(keysMatch, "every instance shares its group's pass, program, asset and LOD");
+		Check(distinct, "neighbouring groups differ, so no group is split");
+		Check(instancesMatch, "instances follow their keys through the sort");
+	}
+}
+
+/// <summary>
+/// Spawns and destroys bodies from this thread, some tied together by constraints, while the simulation
+/// thread steps the world, then checks that the world, the pools and the scene agree about what is left.
+/// </summary>
+static void TestPhysicsChurn() {
+	std::cout << "Physics churn" << std::endl;
+	btDefaultCollisionConfiguration collisionConfiguration;
+	btCollisionDispatcher dispatcher(&collisionConfiguration);
+	btDbvtBroadphase broadphase;
+	btSequentialImpulseConstraintSolver solver;
+	btDiscreteDynamicsWorld world(&dispatcher, &broadphase, &solver, &collisionConfiguration);
+	world.setGravity(btVector3(0, -10, 0));
+	btBoxShape groundShape(btVector3(50, 1, 50));
+	btSphereShape sphereShape(0.5f);
+
+	Scene scene;
+	PhysicsPools pools;
+	std::atomic<unsigned int> ticks{ 0 };
+	SimulationThread simulation(&world, 1.0f / 240.0f, [&ticks](const SimulationInput&, float, SimulationOutput&) {
+		ticks++;
+	});
+
+	Entity ground = scene.Create("ground");
+	spawnPhysicsBody(scene, simulation, pools, ground, btTransform(btQuaternion::getIdentity(), btVector3(0, -1, 0)), 0.0f, &groundShape);
+	simulation.Start();
+
+	std::mt19937 random(7);
+	std::vector<Entity> live;
+	bool ownersUnique = true;
+	const int OPERATIONS = 3000;
+	for (int i = 0; i < OPERATIONS; i++) {
+		if (live.empty() || random() % 5 < 3) {
+			Entity entity = scene.Create("churn");
+			btTransform transform(btQuaternion::getIdentity(), btVector3((float)(random() % 40) - 20.0f, 2.0f + random() % 10, (float)(random() % 40) - 20.0f));
+			spawnPhysicsBody(scene, simulation, pools, entity, transform, 1.0f, &sphereShape);
+			// now and then tie it to the last one; destroying either end takes the constraint with it
+			if (!live.empty() && random() % 4 == 0) {
+				Entity other = live.back();
+				simulation.Enqueue([&pools, entity, other](btDiscreteDynamicsWorld* world) {
+					const PhysicsBody* a = pools.bodies.Find(entity);
+					const PhysicsBody* b = pools.bodies.Find(other);
+					if (!a || !b)
+						return;
+					btGeneric6DofConstraint* constraint = pools.constraints.Get(pools.constraints.Create(*pools.rigidBodies.Get(a->body),
+						*pools.rigidBodies.Get(b->body), btTransform::getIdentity(), btTransform::getIdentity(), true));
+					world->addConstraint(constraint);
+				});
+			}
+			live.push_back(entity);
+		}
+		else {
+			size_t victim = random() % live.size();
+			destroyEntity(scene, simulation, pools, live[victim]);
+			live[victim] = live.back();
+			live.pop_back();
+		}
+
+		if (i % 16 == 0) {
+			// let the simulation step between bursts, and look at what it publishes meanwhile
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			float alpha;
+			std::vector<int> owners = simulation.Latest(alpha).owners;
+			std::sort(owners.begin(), owners.end());
+			ownersUnique = ownersUnique && std::adjacent_find(owners.begin(), owners.end()) == owners.end();
+		}
+	}
+	unsigned int churnTicks = ticks.load();
+	simulation.Stop();
+
+	Check(churnTicks > 10, "the world stepped while bodies came and went");
+	Check(ownersUnique, "no snapshot names an owner twice");
+
+	size_t expected = live.size() + 1;
+	Check(pools.bodies.Size() == expected && pools.rigidBodies.Count() == expected && pools.motionStates.Count() == expected,
+		"the pools hold exactly the live entities' bodies");
+	Check(world.getNumCollisionObjects() == (int)expected, "the world holds exactly the live entities' bodies");
+	Check(pools.constraints.Count() == (size_t)world.getNumConstraints(), "every pooled constraint is in the world, and no other");
+
+	bool matched = pools.bodies.Find(ground) != nullptr;
+	for (Entity entity : live) {
+		const PhysicsBody* body = pools.bodies.Find(entity);
+		matched = matched && body && pools.rigidBodies.Get(body->body)->getUserIndex() == (int)entity.id && scene.IsAlive(entity);
+	}
+	Check(matched, "every live entity has its own body, carrying its id");
+
+	// with the simulation stopped this empties everything right away
+	while (scene.transforms.Size() > 0)
+		destroyEntity(scene, simulation, pools, scene.transforms.EntityAt(scene.transforms.Size() - 1));
+	Check(world.getNumCollisionObjects() == 0 && world.getNumConstraints() == 0, "destroying every entity empties the world");
+	Check(pools.bodies.Size() == 0 && pools.rigidBodies.Count() == 0 && pools.motionStates.Count() == 0 && pools.constraints.Count() == 0,
+		"destroying every entity empties the pools");
+}
+
+int RunSelfTests() {
+	failures = 0;
+	TestRenderKey();
+	TestRenderQueue();
+	TestPhysicsChurn();
+	if (failures == 0)
+		std::cout << "All self tests passed" << std::endl;
+	else
+		std::cout << failures << " self test checks failed" << std::endl;
+	return failures;
+}
@@ -0,0 +1,218 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+
+#include "headers/ShaderCache.hpp"
+#include "headers/MappedFile.hpp"
+#include "headers/Hash.hpp"
+
+static const char PROGRAM_BINARY_MAGIC[4] = { 'B', 'P', 'R', 'G' };
+static const unsigned int PROGRAM_BINARY_FORMAT_VERSION = 1;
+
+// File layout: header, then binaryLength bytes of glGetProgramBinary output.
+struct ProgramBinaryHeader {
+	char magic[4];
+	unsigned int formatVersion;
+	unsigned long long sourceHash; // preprocessed sources, GL_RENDERER and GL_VERSION
+	unsigned int binaryFormat;
+	unsigned int binaryLength;
+};
+
+bool readShaderSource(const std::string& path, const std::vector<std::string>& defines, std::string& out_source) {
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream)
+		return false;
+	std::stringstream ss;
+	ss << stream.rdbuf();
+	out_source = ss.str();
+
+	std::string defineLines;
+	for (const std::string& define : defines)
+		defineLines += "#define " + define + "\n";
+
+	// #version has to stay the first line
+	size_t versionLine = out_source.find("#version");
+	size_t insertAt = versionLine == std::string::npos ? 0 : out_source.find('\n', versionLine);
+	if (insertAt == std::string::npos) {
+		out_source += '\n';
+		insertAt = out_source.size();
+	}
+	else if (versionLine != std::string::npos) {
+		insertAt++;
+	}
+	out_source.insert(insertAt, defineLines);
+	return true;
+}
+
+static GLuint compileShader(GLenum type, const std::string& source, const std::string& path) {
+	GLuint id = glCreateShader(type);
+	const char* src = source.c_str();
+	glShaderSource(id, 1, &src, nullptr);
+	glCompileShader(id);
+
+	GLint result;
+	glGetShaderiv(id, GL_COMPILE_STATUS, &result);
+	if (result == GL_FALSE) {
+		GLint length;
+		glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
+		std::vector<char> message(length + 1);
+		glGetShaderInfoLog(id, length, &length, &message[0]);
+		std::cout << "Failed to compile " << path << std::endl;
+		std::cout << &message[0] << std::endl;
+		glDeleteShader(id);
+		return 0;
+	}
+	return id;
+}
+
+static bool linkSucceeded(GLuint program, bool printLog) {
+	GLint result;
+	glGetProgramiv(program, GL_LINK_STATUS, &result);
+	if (result == GL_FALSE && printLog) {
+		GLint length;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+		std::vector<char> message(length + 1);
+		glGetProgramInfoLog(program, length, &length, &message[0]);
+		std::cout << "Failed to link program" << std::endl;
+		std::cout << &message[0] << std::endl;
+	}
+	return result != GL_FALSE;
+}
+
+static bool programBinariesSupported() {
+	if (!GLEW_ARB_get_program_binary && !GLEW_VERSION_4_1)
+		return false;
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+// One file per program and permutation, so a changed source or driver overwrites its entry instead of adding one.
+static std::string cachePathFor(const ShaderProgramDesc& desc) {
+	unsigned long long identity = hashBytes(desc.fragmentPath.data(), desc.fragmentPath.size());
+	for (const std::string& define : desc.defines)
+		identity = hashBytes(define.c_str(), define.size() + 1, identity);
+
+	std::string path = desc.vertexPath;
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+		path.erase(dot);
+
+	char suffix[24];
+	snprintf(suffix, sizeof(suffix), ".%016llx", identity);
+	return path + suffix + ".bprog";
+}
+
+static GLuint loadProgramBinary(const std::string& cachePath, unsigned long long key) {
+	MappedFile file;
+	if (!file.Open(cachePath.c_str()) || file.Size() < sizeof(ProgramBinaryHeader))
+		return 0;
+
+	ProgramBinaryHeader header;
+	memcpy(&header, file.Data(), sizeof(header));
+	if (memcmp(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic)) != 0 ||
+		header.formatVersion != PROGRAM_BINARY_FORMAT_VERSION ||
+		header.sourceHash != key ||
+		sizeof(header) + (unsigned long long)header.binaryLength > file.Size())
+		return 0;
+
+	// the driver can still refuse a binary it wrote, e.g. after an update that kept the version string
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.binaryFormat, file.Data() + sizeof(header), header.binaryLength);
+	if (!linkSucceeded(program, false)) {
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+static bool saveProgramBinary(const std::string& cachePath, unsigned long long key, GLuint program) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return false;
+
+	ProgramBinaryHeader header = {};
+	memcpy(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic));
+	header.formatVersion = PROGRAM_BINARY_FORMAT_VERSION;
+	header.sourceHash = key;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, &binary[0]);
+	header.binaryFormat = format;
+	header.binaryLength = (unsigned int)length;
+
+	// write to a temporary file and swap it in, so a crash never leaves a half written cache
+	std::string tempPath = cachePath + ".tmp";
+	FILE* file = NULL;
+	fopen_s(&file, tempPath.c_str(), "wb");
+	if (file == NULL)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(&binary[0], length, 1, file) == 1;
+	ok = fclose(file) == 0 && ok;
+
+	if (ok) {
+		remove(cachePath.c_str());
+		ok = rename(tempPath.c_str(), cachePath.c_str()) == 0;
+	}
+	if (!ok)
+		remove(tempPath.c_str());
+	return ok;
+}
+
+GLuint loadShaderProgram(const ShaderProgramDesc& desc) {
+	std::string vertexSource, fragmentSource;
+	if (!readShaderSource(desc.vertexPath, desc.defines, vertexSource) ||
+		!readShaderSource(desc.fragmentPath, desc.defines, fragmentSource)) {
+		std::cout << "Couldn't open " << desc.vertexPath << " or " << desc.fragmentPath << std::endl;
+		return 0;
+	}
+
+	const bool cacheable = programBinariesSupported();
+	std::string cachePath;
+	unsigned long long key = 0;
+	if (cacheable) {
+		const char* renderer = (const char*)glGetString(GL_RENDERER);
+		const char* version = (const char*)glGetString(GL_VERSION);
+		key = hashBytes(vertexSource.c_str(), vertexSource.size() + 1);
+		key = hashBytes(fragmentSource.c_str(), fragmentSource.size() + 1, key);
+		key = hashBytes(renderer, strlen(renderer) + 1, key);
+		key = hashBytes(version, strlen(version) + 1, key);
+
+		cachePath = cachePathFor(desc);
+		GLuint program = loadProgramBinary(cachePath, key);
+		if (program)
+			return program;
+	}
+
+	GLuint vs = compileShader(GL_VERTEX_SHADER, vertexSource, desc.vertexPath);
+	GLuint fs = compileShader(GL_FRAGMENT_SHADER, fragmentSource, desc.fragmentPath);
+	if (!vs || !fs) {
+		glDeleteShader(vs);
+		glDeleteShader(fs);
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	if (cacheable)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glAttachShader(program, vs);
+	glAttachShader(program, fs);
+	glLinkProgram(program);
+	glDetachShader(program, vs);
+	glDetachShader(program, fs);
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+	if (!linkSucceeded(program, true)) {
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	std::cout << "Compiled " << desc.vertexPath << " + " << desc.fragmentPath << std::endl;
+	if (cacheable && !saveProgramBinary(cachePath, key, program))
+		std::cout << "Couldn't write program cache " << cachePath << std::endl;
+	return program;
+}
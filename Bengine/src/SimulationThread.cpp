@@ -0,0 +1,138 @@
+#include "headers/SimulationThread.hpp"
+
+// a hitch longer than this many ticks is dropped instead of stepped through back to back
+static const int MAX_LAG_TICKS = 5;
+
+btTransform interpolatePose(const BodyPose& from, const BodyPose& to, float t) {
+	// normalized lerp along the shorter arc; one tick of rotation is small enough that it tracks a slerp
+	btQuaternion target = from.rotation.dot(to.rotation) < 0 ? -to.rotation : to.rotation;
+	btQuaternion rotation = from.rotation + (target - from.rotation) * t;
+	return btTransform(rotation.normalized(), from.origin.lerp(to.origin, t));
+}
+
+SimulationThread::SimulationThread(btDiscreteDynamicsWorld* world, float tickSeconds, StepCallback beforeStep)
+	: world(world), tickSeconds(tickSeconds), beforeStep(beforeStep) {
+}
+
+SimulationThread::~SimulationThread() {
+	Stop();
+}
+
+void SimulationThread::Start() {
+	if (running)
+		return;
+
+	// publish the starting poses so the renderer has something to draw before the first tick
+	TransformSnapshot& snapshot = snapshots.WriteSlot();
+	Capture(snapshot.current, &snapshot.owners);
+	snapshot.previous = snapshot.current;
+	snapshot.output = SimulationOutput();
+	snapshot.time = 0.0;
+	snapshots.Publish();
+
+	start = Clock::now();
+	running = true;
+	thread = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop() {
+	running = false;
+	if (thread.joinable())
+		thread.join();
+	// whatever was queued after the last tick still happens, so nothing queued is lost
+	RunCommands();
+}
+
+void SimulationThread::SetInput(const SimulationInput& input) {
+	inputs.WriteSlot() = input;
+	inputs.Publish();
+}
+
+void SimulationThread::Enqueue(Command command) {
+	if (!running) {
+		command(world);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(commandMutex);
+	commands.push_back(std::move(command));
+}
+
+void SimulationThread::RunCommands() {
+	{
+		// swap rather than run under the lock, so the render thread is never held up by a command
+		std::lock_guard<std::mutex> lock(commandMutex);
+		runningCommands.swap(commands);
+	}
+	for (Command& command : runningCommands)
+		command(world);
+	runningCommands.clear();
+}
+
+const TransformSnapshot& SimulationThread::Latest(float& out_alpha) {
+	snapshots.Update();
+	const TransformSnapshot& snapshot = snapshots.ReadSlot();
+	float alpha = (float)((Seconds(Clock::now()) - snapshot.time) / tickSeconds);
+	out_alpha = glm::clamp(alpha, 0.0f, 1.0f);
+	return snapshot;
+}
+
+double SimulationThread::Seconds(Clock::time_point t) const {
+	return std::chrono::duration<double>(t - start).count();
+}
+
+void SimulationThread::Capture(std::vector<BodyPose>& out_poses, std::vector<int>* out_owners) const {
+	const btCollisionObjectArray& objects = world->getCollisionObjectArray();
+	out_poses.resize(objects.size());
+	if (out_owners)
+		out_owners->resize(objects.size());
+	for (int i = 0; i < objects.size(); i++) {
+		if (out_owners)
+			(*out_owners)[i] = objects[i]->getUserIndex();
+		const btRigidBody* body = btRigidBody::upcast(objects[i]);
+		btTransform transform;
+		if (body && body->getMotionState())
+			body->getMotionState()->getWorldTransform(transform);
+		else
+			transform = objects[i]->getWorldTransform();
+		out_poses[i].origin = transform.getOrigin();
+		out_poses[i].rotation = transform.getRotation();
+	}
+}
+
+void SimulationThread::Run() {
+	const Clock::duration tick = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(tickSeconds));
+	Clock::time_point next = start + tick;
+
+	while (running) {
+		std::this_thread::sleep_until(next);
+
+		RunCommands();
+
+		inputs.Update();
+		const SimulationInput& input = inputs.ReadSlot();
+		if (!input.paused) {
+			Clock::time_point stepStart = Clock::now();
+			TransformSnapshot& snapshot = snapshots.WriteSlot();
+			if (beforeStep)
+				beforeStep(input, tickSeconds, snapshot.output);
+
+			// capture around the step rather than reusing the last tick's poses, so objects the callback
+			// added or removed still line up
+			Capture(snapshot.previous);
+			// exactly one internal step of exactly one tick, so Bullet never interpolates or substeps on its own
+			world->stepSimulation(tickSeconds, 1, tickSeconds);
+			Capture(snapshot.current, &snapshot.owners);
+			snapshot.time = Seconds(next);
+			snapshots.Publish();
+
+			stepMilliseconds.store(std::chrono::duration<float, std::milli>(Clock::now() - stepStart).count(), std::memory_order_relaxed);
+		}
+
+		next += tick;
+		Clock::time_point now = Clock::now();
+		if (now - next > tick * MAX_LAG_TICKS) {
+			droppedTicks.fetch_add((unsigned int)((now - next) / tick), std::memory_order_relaxed);
+			next = now;
+		}
+	}
+}
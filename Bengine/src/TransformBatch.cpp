@@ -0,0 +1,119 @@
+#include <xmmintrin.h>
+
+#include "headers/TransformBatch.hpp"
+
+void TransformBatch::Resize(size_t count) {
+	this->count = count;
+	padded = (count + 3) & ~(size_t)3;
+	for (std::vector<float>& element : model)
+		element.resize(padded, 0.0f);
+	for (std::vector<float>& element : modelView)
+		element.resize(padded);
+	for (std::vector<float>& element : modelViewProjection)
+		element.resize(padded);
+	for (std::vector<float>& element : normal)
+		element.resize(padded);
+}
+
+void TransformBatch::Set(size_t object, const btTransform& transform) {
+	const btMatrix3x3& basis = transform.getBasis();
+	const btVector3& origin = transform.getOrigin();
+	for (int row = 0; row < 3; row++) {
+		model[row * 4 + 0][object] = basis[row].x();
+		model[row * 4 + 1][object] = basis[row].y();
+		model[row * 4 + 2][object] = basis[row].z();
+		model[row * 4 + 3][object] = origin[row];
+	}
+}
+
+// out = m * model for the four objects at i, where m is any 4x4 and model is affine.
+// Only the first rowCount rows of the product are written.
+static inline void MultiplyAffine(const glm::mat4& m, const std::vector<float>* model, std::vector<float>* out, int rowCount, size_t i) {
+	__m128 element[12];
+	for (int k = 0; k < 12; k++)
+		element[k] = _mm_loadu_ps(&model[k][i]);
+
+	for (int row = 0; row < rowCount; row++) {
+		// glm is column major: m[column][row]
+		__m128 m0 = _mm_set1_ps(m[0][row]), m1 = _mm_set1_ps(m[1][row]), m2 = _mm_set1_ps(m[2][row]);
+		for (int column = 0; column < 4; column++) {
+			__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, element[column]), _mm_mul_ps(m1, element[4 + column])), _mm_mul_ps(m2, element[8 + column]));
+			if (column == 3)
+				sum = _mm_add_ps(sum, _mm_set1_ps(m[3][row]));
+			_mm_storeu_ps(&out[row * 4 + column][i], sum);
+		}
+	}
+}
+
+void TransformBatch::Compute(const glm::mat4& view, const glm::mat4& proj) {
+	const glm::mat4 viewProj = proj * view;
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (size_t i = 0; i < padded; i += 4) {
+		MultiplyAffine(view, model, modelView, 3, i);
+		MultiplyAffine(viewProj, model, modelViewProjection, 4, i);
+
+		// inverse transpose of the basis = cofactors / determinant; for a pure rotation it's the basis itself
+		__m128 a = _mm_loadu_ps(&model[0][i]), b = _mm_loadu_ps(&model[1][i]), c = _mm_loadu_ps(&model[2][i]);
+		__m128 d = _mm_loadu_ps(&model[4][i]), e = _mm_loadu_ps(&model[5][i]), f = _mm_loadu_ps(&model[6][i]);
+		__m128 g = _mm_loadu_ps(&model[8][i]), h = _mm_loadu_ps(&model[9][i]), k = _mm_loadu_ps(&model[10][i]);
+
+		__m128 cofactor[9] = {
+			_mm_sub_ps(_mm_mul_ps(e, k), _mm_mul_ps(f, h)),
+			_mm_sub_ps(_mm_mul_ps(f, g), _mm_mul_ps(d, k)),
+			_mm_sub_ps(_mm_mul_ps(d, h), _mm_mul_ps(e, g)),
+			_mm_sub_ps(_mm_mul_ps(c, h), _mm_mul_ps(b, k)),
+			_mm_sub_ps(_mm_mul_ps(a, k), _mm_mul_ps(c, g)),
+			_mm_sub_ps(_mm_mul_ps(b, g), _mm_mul_ps(a, h)),
+			_mm_sub_ps(_mm_mul_ps(b, f), _mm_mul_ps(c, e)),
+			_mm_sub_ps(_mm_mul_ps(c, d), _mm_mul_ps(a, f)),
+			_mm_sub_ps(_mm_mul_ps(a, e), _mm_mul_ps(b, d))
+		};
+		__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, cofactor[0]), _mm_mul_ps(b, cofactor[1])), _mm_mul_ps(c, cofactor[2]));
+		// padding lanes are all zero; keep them finite
+		__m128 invDeterminant = _mm_div_ps(one, _mm_or_ps(_mm_and_ps(_mm_cmpneq_ps(determinant, _mm_setzero_ps()), determinant),
+			_mm_and_ps(_mm_cmpeq_ps(determinant, _mm_setzero_ps()), one)));
+		for (int n = 0; n < 9; n++)
+			_mm_storeu_ps(&normal[n][i], _mm_mul_ps(cofactor[n], invDeterminant));
+	}
+}
+
+void TransformBatch::GetInstance(size_t object, InstanceData& out_instance) const {
+	out_instance.modelViewProjection = ModelViewProjection(object);
+	for (int row = 0; row < 3; row++) {
+		out_instance.model[row] = glm::vec4(model[row * 4][object], model[row * 4 + 1][object], model[row * 4 + 2][object], model[row * 4 + 3][object]);
+		out_instance.normal[row] = glm::vec4(normal[row * 3][object], normal[row * 3 + 1][object], normal[row * 3 + 2][object], 0.0f);
+	}
+	// view depth is minus view space z
+	out_instance.viewDepth = -glm::vec4(modelView[8][object], modelView[9][object], modelView[10][object], modelView[11][object]);
+}
+
+static glm::mat4 GatherRows(const std::vector<float>* elements, int rowCount, size_t object) {
+	glm::mat4 m(1.0f);
+	for (int row = 0; row < rowCount; row++) {
+		for (int column = 0; column < 4; column++)
+			m[column][row] = elements[row * 4 + column][object];
+	}
+	return m;
+}
+
+glm::mat4 TransformBatch::Model(size_t object) const {
+	return GatherRows(model, 3, object);
+}
+
+glm::mat4 TransformBatch::ModelView(size_t object) const {
+	return GatherRows(modelView, 3, object);
+}
+
+glm::mat4 TransformBatch::ModelViewProjection(size_t object) const {
+	return GatherRows(modelViewProjection, 4, object);
+}
+
+glm::mat3 TransformBatch::Normal(size_t object) const {
+	glm::mat3 m;
+	for (int row = 0; row < 3; row++) {
+		for (int column = 0; column < 3; column++)
+			m[column][row] = normal[row * 3 + column][object];
+	}
+	return m;
+}
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "headers/UniformRing.hpp"
+
+void UniformRing::Create(size_t bytesPerFrame) {
+	GLint offsetAlignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+	alignment = std::max<size_t>(offsetAlignment, 16); // instance attributes want at least this much
+	persistent = GLEW_ARB_buffer_storage || GLEW_VERSION_4_4;
+	partitionSize = AlignedSize(bytesPerFrame);
+	partition = FRAMES_IN_FLIGHT - 1; // so the first BeginFrame lands on partition 0
+	CreateStorage();
+}
+
+void UniformRing::CreateStorage() {
+	const size_t size = partitionSize * FRAMES_IN_FLIGHT;
+
+	// a binding point nothing draws from, so creating the buffer doesn't disturb vertex or uniform bindings
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (persistent) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+		mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+	}
+	else {
+		glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void UniformRing::Destroy() {
+	for (GLsync& fence : fences) {
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+	if (buffer) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		if (mapped)
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+	}
+	buffer = 0;
+	mapped = nullptr;
+}
+
+void UniformRing::WaitForPartition(unsigned int index) {
+	GLsync& fence = fences[index];
+	if (!fence)
+		return;
+
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		stalls++;
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void UniformRing::BeginFrame(size_t bytes) {
+	partition = (partition + 1) % FRAMES_IN_FLIGHT;
+	used = 0;
+	requested = 0;
+	bytes = std::max(bytes, shortfall);
+	shortfall = 0;
+
+	if (bytes > partitionSize) {
+		// every partition moves, so everything in flight has to finish first
+		for (unsigned int i = 0; i < FRAMES_IN_FLIGHT; i++)
+			WaitForPartition(i);
+		Destroy();
+		partitionSize = AlignedSize(std::max(bytes, partitionSize * 2));
+		CreateStorage();
+	}
+	else {
+		WaitForPartition(partition);
+	}
+
+	if (!persistent) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, partition * partitionSize, partitionSize,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+}
+
+size_t UniformRing::Allocate(size_t size, void** out_data) {
+	size_t offset = used;
+	requested += AlignedSize(size);
+	if (used + AlignedSize(size) > partitionSize) {
+		// BeginFrame was told too little
+#ifdef _DEBUG
+		__debugbreak();
+#endif
+		if (shortfall == 0)
+			printf("Uniform ring: frame needs more than its %u bytes, skipping draws until it grows\n", (unsigned int)partitionSize);
+		shortfall = requested;
+		if (overflowScratch.size() < size)
+			overflowScratch.resize(size);
+		*out_data = &overflowScratch[0];
+		return OVERFLOWED;
+	}
+	used += AlignedSize(size);
+
+	*out_data = persistent ? mapped + partition * partitionSize + offset : mapped + offset;
+	return partition * partitionSize + offset;
+}
+
+void UniformRing::Flush() {
+	if (persistent)
+		return; // coherent, so the writes are already visible to commands issued from here on
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	mapped = nullptr;
+}
+
+void UniformRing::EndFrame() {
+	fences[partition] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,156 @@
+#include <cstring>
+#include <gtc/packing.hpp>
+
+#include "headers/VertexLayout.hpp"
+
+VertexLayout VertexLayout::Get(VertexLayoutId id) {
+	VertexLayout layout = {};
+	layout.id = id;
+	switch (id) {
+	case VertexLayoutId::Float:
+		layout.attributes[0] = { VertexSemantic::Position, VertexFormat::Float3, 0 };
+		layout.attributes[1] = { VertexSemantic::Normal, VertexFormat::Float3, 12 };
+		layout.attributes[2] = { VertexSemantic::Color, VertexFormat::Float4, 24 };
+		layout.attributeCount = 3;
+		layout.stride = 40;
+		break;
+	case VertexLayoutId::Compact:
+		layout.attributes[0] = { VertexSemantic::Position, VertexFormat::Snorm16x4, 0 };
+		layout.attributes[1] = { VertexSemantic::Normal, VertexFormat::OctSnorm16x2, 8 };
+		layout.attributeCount = 2;
+		layout.stride = 12;
+		break;
+	case VertexLayoutId::CompactColor:
+		layout.attributes[0] = { VertexSemantic::Position, VertexFormat::Snorm16x4, 0 };
+		layout.attributes[1] = { VertexSemantic::Normal, VertexFormat::OctSnorm16x2, 8 };
+		layout.attributes[2] = { VertexSemantic::Color, VertexFormat::Unorm8x4, 12 };
+		layout.attributeCount = 3;
+		layout.stride = 16;
+		break;
+	case VertexLayoutId::Half:
+		layout.attributes[0] = { VertexSemantic::Position, VertexFormat::Half4, 0 };
+		layout.attributes[1] = { VertexSemantic::Normal, VertexFormat::OctSnorm16x2, 8 };
+		layout.attributeCount = 2;
+		layout.stride = 12;
+		break;
+	}
+	return layout;
+}
+
+const VertexAttribute* VertexLayout::Find(VertexSemantic semantic) const {
+	for (unsigned int i = 0; i < attributeCount; i++) {
+		if (attributes[i].semantic == semantic)
+			return &attributes[i];
+	}
+	return nullptr;
+}
+
+bool VertexLayout::QuantizesPositions() const {
+	const VertexAttribute* position = Find(VertexSemantic::Position);
+	return position && position->format == VertexFormat::Snorm16x4;
+}
+
+unsigned int vertexFormatComponents(VertexFormat format) {
+	switch (format) {
+	case VertexFormat::Float3: return 3;
+	case VertexFormat::OctSnorm16x2: return 2;
+	default: return 4;
+	}
+}
+
+bool vertexFormatNormalized(VertexFormat format) {
+	return format == VertexFormat::Snorm16x4 || format == VertexFormat::OctSnorm16x2 || format == VertexFormat::Unorm8x4;
+}
+
+// Octahedral encoding: project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over.
+static glm::vec2 octEncode(glm::vec3 n) {
+	n /= (fabs(n.x) + fabs(n.y) + fabs(n.z) + 1e-20f);
+	glm::vec2 e(n.x, n.y);
+	if (n.z < 0.0f) {
+		e = glm::vec2(
+			(1.0f - fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+	}
+	return e;
+}
+
+void vertexPositionDecode(const VertexLayout& layout, glm::vec3 boundsMin, glm::vec3 boundsMax,
+	glm::vec3& out_offset, glm::vec3& out_scale) {
+
+	if (!layout.QuantizesPositions()) {
+		out_offset = glm::vec3(0.0f);
+		out_scale = glm::vec3(1.0f);
+		return;
+	}
+	out_offset = (boundsMin + boundsMax) * 0.5f;
+	out_scale = glm::max((boundsMax - boundsMin) * 0.5f, glm::vec3(1e-6f));
+}
+
+static void packAttribute(VertexFormat format, glm::vec4 value, unsigned char* out) {
+	switch (format) {
+	case VertexFormat::Float3:
+		memcpy(out, &value[0], 3 * sizeof(float));
+		break;
+	case VertexFormat::Float4:
+		memcpy(out, &value[0], 4 * sizeof(float));
+		break;
+	case VertexFormat::Half4: {
+		glm::uint64 packed = glm::packHalf4x16(value);
+		memcpy(out, &packed, sizeof(packed));
+		break;
+	}
+	case VertexFormat::Snorm16x4: {
+		glm::uint64 packed = glm::packSnorm4x16(value);
+		memcpy(out, &packed, sizeof(packed));
+		break;
+	}
+	case VertexFormat::OctSnorm16x2: {
+		glm::uint32 packed = glm::packSnorm2x16(octEncode(glm::vec3(value)));
+		memcpy(out, &packed, sizeof(packed));
+		break;
+	}
+	case VertexFormat::Unorm8x4: {
+		glm::uint32 packed = glm::packUnorm4x8(value);
+		memcpy(out, &packed, sizeof(packed));
+		break;
+	}
+	}
+}
+
+void packVertices(
+	const std::vector<float>& vbo,
+	int vertex_size,
+	const VertexLayout& layout,
+	glm::vec3 boundsMin,
+	glm::vec3 boundsMax,
+	glm::vec4 color,
+	std::vector<unsigned char>& out_packed) {
+
+	glm::vec3 offset, scale;
+	vertexPositionDecode(layout, boundsMin, boundsMax, offset, scale);
+
+	size_t vertexCount = vbo.size() / vertex_size;
+	out_packed.assign(vertexCount * layout.stride, 0);
+
+	for (size_t i = 0; i < vertexCount; i++) {
+		const float* vertex = &vbo[i * vertex_size];
+		unsigned char* out = &out_packed[i * layout.stride];
+
+		for (unsigned int a = 0; a < layout.attributeCount; a++) {
+			const VertexAttribute& attribute = layout.attributes[a];
+			glm::vec4 value;
+			switch (attribute.semantic) {
+			case VertexSemantic::Position:
+				value = glm::vec4((glm::vec3(vertex[0], vertex[1], vertex[2]) - offset) / scale, 1.0f);
+				break;
+			case VertexSemantic::Normal:
+				value = glm::vec4(vertex[3], vertex[4], vertex[5], 0.0f);
+				break;
+			case VertexSemantic::Color:
+				value = color;
+				break;
+			}
+			packAttribute(attribute.format, value, out + attribute.offset);
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+#include "MeshCache.hpp"
+#include "GpuMeshPool.hpp"
+#include "JobSystem.hpp"
+
+// One imported mesh, shared by every Mesh that uses the same file and import settings.
+struct MeshAsset : ImportedMesh {
+	std::string path;
+	MeshImportSettings settings;
+	bool loaded = false;
+
+	GpuMeshRange gpu; // where the asset lives in the GpuMeshPool, once uploaded
+};
+
+// Deduplicates mesh imports by path and import settings.
+class AssetRegistry {
+public:
+	// Returns the index of the asset for path and settings, registering it if it is new.
+	unsigned int RequestMesh(const char* path, const MeshImportSettings& settings);
+
+	// Imports every registered asset that isn't loaded yet, one job per asset.
+	void LoadAll(JobSystem& jobs);
+
+	MeshAsset& GetMesh(unsigned int index) { return *meshAssets[index]; }
+	const MeshAsset& GetMesh(unsigned int index) const { return *meshAssets[index]; }
+	unsigned int MeshCount() const { return (unsigned int)meshAssets.size(); }
+
+private:
+	std::vector<std::unique_ptr<MeshAsset>> meshAssets;
+	std::unordered_map<std::string, std::vector<unsigned int>> meshLookup; // path and settings hash -> assets
+};
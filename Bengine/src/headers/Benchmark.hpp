@@ -0,0 +1,5 @@
+#pragma once
+
+// Runs the engine's CPU-side benchmarks and prints the results. No window or GL context is needed.
+// Launch with "Bengine.exe --benchmark".
+void RunBenchmarks();
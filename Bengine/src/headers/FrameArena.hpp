@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// Bump allocator for memory that all dies at once. Allocating moves a cursor; nothing is freed on its own,
+// Reset drops everything in O(1). Only one thread may use an arena at a time.
+class LinearArena {
+public:
+	LinearArena() = default;
+	explicit LinearArena(size_t capacity);
+	~LinearArena();
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	// Grows the block to at least capacity bytes. Anything allocated before is lost, so call it right after a Reset.
+	void Reserve(size_t capacity);
+
+	// alignment must be a power of two. When the block is full this falls back to the heap, and the next
+	// Reset grows the block to fit, so a run of the same size only ever touches the heap once.
+	void* Allocate(size_t size, size_t alignment = 16);
+
+	template <typename T>
+	T* Allocate(size_t count) { return (T*)Allocate(count * sizeof(T), alignof(T)); }
+
+	void Reset();
+
+	size_t Used() const { return used + overflowBytes; }
+	size_t Capacity() const { return capacity; }
+	// Allocations that did not fit the block since the arena was made.
+	unsigned int Overflows() const { return overflows; }
+
+private:
+	unsigned char* block = nullptr;
+	size_t capacity = 0;
+	size_t used = 0;
+	std::vector<void*> overflow; // heap allocations made while full, freed by Reset
+	size_t overflowBytes = 0;
+	unsigned int overflows = 0;
+};
+
+// Standard allocator on top of a LinearArena, for containers that live no longer than the arena's contents.
+// Deallocation does nothing, so reserve up front where you can; every regrowth leaves the old storage behind.
+template <typename T>
+struct ArenaAllocator {
+	typedef T value_type;
+
+	explicit ArenaAllocator(LinearArena& arena) : arena(&arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count) { return arena->Allocate<T>(count); }
+	void deallocate(T*, size_t) {}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+	LinearArena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Scratch memory for data that lives for a frame: one LinearArena per thread for every frame in flight.
+// BeginFrame moves to the next frame's arenas and resets them, so what a frame allocates stays good
+// through the following frame, while anything still reading it (the GPU upload, a late worker) finishes.
+class FrameArena {
+public:
+	static const unsigned int FRAMES_IN_FLIGHT = 2;
+
+	// Thread 0 is the main thread; workers use 1 and up, see JobSystem::ThreadIndex.
+	FrameArena(unsigned int threadCount, size_t bytesPerThread);
+
+	void BeginFrame();
+
+	LinearArena& ForThread(unsigned int thread) { return arenas[frame * threadCount + thread]; }
+	// the calling thread's arena for this frame
+	LinearArena& Local();
+
+	unsigned int ThreadCount() const { return threadCount; }
+	unsigned int Overflows() const;
+
+private:
+	std::vector<LinearArena> arenas; // FRAMES_IN_FLIGHT runs of threadCount
+	unsigned int threadCount;
+	unsigned int frame = 0;
+};
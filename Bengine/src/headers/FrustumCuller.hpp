@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <glm.hpp>
+
+#include "BulletCollision/BroadphaseCollision/btDbvt.h"
+
+// The six planes of a view frustum, pointing inward: a point p is inside plane i when dot(normal, p) + offset >= 0.
+struct Frustum {
+	glm::vec3 normals[6];
+	float offsets[6];
+
+	// Extracts the planes from proj * view, so they are in world space.
+	static Frustum FromMatrix(const glm::mat4& viewProj);
+};
+
+struct CullStats {
+	unsigned int staticObjects = 0;
+	unsigned int staticVisible = 0;
+	unsigned int dynamicObjects = 0;
+	unsigned int dynamicVisible = 0;
+
+	unsigned int Culled() const { return staticObjects + dynamicObjects - staticVisible - dynamicVisible; }
+};
+
+// Culls world space bounding boxes against a frustum.
+// Static objects live in a btDbvt, so culling them costs about what is visible.
+// Dynamic objects move every frame, so they skip the tree and are tested four at a time with SSE.
+class FrustumCuller {
+public:
+	FrustumCuller() = default;
+	FrustumCuller(const FrustumCuller&) = delete;
+	FrustumCuller& operator=(const FrustumCuller&) = delete;
+
+	// Adds an object, or moves it if it's already known. Objects keep whether they were added static.
+	void SetStatic(unsigned int object, const glm::vec3& min, const glm::vec3& max);
+	void SetDynamic(unsigned int object, const glm::vec3& min, const glm::vec3& max);
+	void Remove(unsigned int object);
+	bool Contains(unsigned int object) const;
+
+	// Appends every object whose bounds touch the frustum to out_visible, static ones first.
+	void Cull(const Frustum& frustum, std::vector<unsigned int>& out_visible, CullStats* out_stats = nullptr) const;
+
+private:
+	enum class Kind : unsigned char { None, Static, Dynamic };
+
+	struct ObjectSlot {
+		Kind kind = Kind::None;
+		btDbvtNode* leaf = nullptr; // static
+		unsigned int dynamicIndex = 0; // dynamic
+	};
+
+	std::vector<ObjectSlot> slots;
+	btDbvt staticTree;
+	unsigned int staticCount = 0;
+
+	// dynamic bounds as centers and half extents, one array per component, padded to a multiple of four
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<unsigned int> dynamicObjects;
+};
+
+// Transforms local bounds by model and returns the world space box around the result.
+void transformBounds(const glm::mat4& model, const glm::vec3& localMin, const glm::vec3& localMax, glm::vec3& out_min, glm::vec3& out_max);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <glew.h>
+
+// GL_DIAGNOSTICS turns on GL error reporting; it follows the build configuration unless defined by the project.
+// With KHR_debug the driver reports errors through a callback and GLCALL adds nothing to the call;
+// without it GLCALL falls back to polling glGetError around each call. Release builds compile GLCALL away.
+// Define GL_DIAGNOSTICS_SYNCHRONOUS to get callbacks on the offending call's stack, at the cost of driver threading.
+#ifndef GL_DIAGNOSTICS
+#ifdef _DEBUG
+#define GL_DIAGNOSTICS 1
+#else
+#define GL_DIAGNOSTICS 0
+#endif
+#endif
+
+#define ASSERT(x) if (!(x)) __debugbreak();
+
+#if GL_DIAGNOSTICS
+#define GLCALL(x) do {\
+		if (!glDebugOutputInstalled) GLClearError();\
+		x;\
+		if (!glDebugOutputInstalled) { ASSERT(GLLogCall(#x, __FILE__, __LINE__)) }\
+	} while (0)
+#else
+#define GLCALL(x) x
+#endif
+
+extern bool glDebugOutputInstalled;
+
+void GLClearError();
+bool GLLogCall(const char* function, const char* file, int line);
+
+// Routes driver messages to the console if the context has KHR_debug. Call once after glewInit.
+// Returns false (and leaves GLCALL polling) if it doesn't.
+bool GLInstallDebugOutput();
+
+/// <summary>
+/// GPU time per render pass from GL_TIME_ELAPSED queries. Each pass has two queries used on alternate frames,
+/// so a query is read back when its turn comes round again, two frames after it was issued. By then the GPU is
+/// normally done with it; if not, that frame's read is skipped rather than waited for.
+/// Passes can't nest: only one elapsed time query can be running.
+/// </summary>
+class GpuTimer {
+public:
+	unsigned int AddPass(const char* name);
+
+	void Begin(unsigned int pass);
+	void End();
+	// Flips to the other set of queries. Call once per frame, after the last pass.
+	void EndFrame();
+
+	// Latest finished measurement, in milliseconds.
+	double Milliseconds(unsigned int pass) const { return passes[pass].milliseconds; }
+	const char* Name(unsigned int pass) const { return passes[pass].name; }
+	unsigned int PassCount() const { return (unsigned int)passes.size(); }
+
+	void Destroy();
+
+private:
+	struct Pass {
+		const char* name;
+		GLuint queries[2] = { 0, 0 };
+		bool issued[2] = { false, false };
+		double milliseconds = 0.0;
+	};
+
+	std::vector<Pass> passes;
+	unsigned int frame = 0; // which query of each pair this frame issues
+	int activePass = -1;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+
+#include "MeshCache.hpp"
+
+// Where a mesh landed in the pool's shared buffers.
+struct GpuMeshRange {
+	int baseVertex = 0; // added to every index of the mesh, including chunk base vertices
+	size_t indexOffset = 0; // bytes into the index buffer, aligned to the mesh's index size
+};
+
+// Holds every static mesh in one vertex buffer and one index buffer, uploaded once at load time.
+// Meshes keep their own index width; draws pass the range's offset and base vertex.
+// All meshes must be packed in the same VertexLayout.
+class GpuMeshPool {
+public:
+	GpuMeshPool() = default;
+	GpuMeshPool(const GpuMeshPool&) = delete;
+	GpuMeshPool& operator=(const GpuMeshPool&) = delete;
+
+	// Lays out room for the mesh's gpuVertices and indices. The mesh must stay alive until Upload.
+	GpuMeshRange Reserve(const ImportedMesh& mesh, unsigned int vertexStride);
+
+	// Creates the buffers, sized for everything reserved, and copies every mesh in.
+	// Leaves them bound to GL_ARRAY_BUFFER and GL_ELEMENT_ARRAY_BUFFER.
+	void Upload();
+
+	// Reads the buffers back and compares them with the reserved meshes, so it has to run
+	// before their CPU copies are released. Returns false and prints the first mismatch otherwise.
+	bool Validate() const;
+
+	// Deletes the buffers. Needs the context, so call it before the window goes away.
+	void Destroy();
+
+	unsigned int VertexBuffer() const { return vertexBuffer; }
+	unsigned int IndexBuffer() const { return indexBuffer; }
+	size_t VertexBytes() const { return vertexBytes; }
+	size_t IndexBytes() const { return indexBytes; }
+
+private:
+	struct Entry {
+		const ImportedMesh* mesh;
+		size_t vertexOffset;
+		size_t indexOffset;
+	};
+
+	std::vector<Entry> entries;
+	size_t vertexBytes = 0;
+	size_t indexBytes = 0;
+	unsigned int vertexStride = 0;
+	unsigned int vertexBuffer = 0;
+	unsigned int indexBuffer = 0;
+};
+
+// Frees the CPU copies of a mesh that only the GPU needs anymore. Drawing metadata
+// (LODs, chunks, index width, bounds) stays. keepCollisionData keeps vbo and indices,
+// for meshes that collision shapes point into.
+void releaseCpuGeometry(ImportedMesh& mesh, bool keepCollisionData);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+// 64-bit FNV-1a. Chain calls by passing the previous result as seed.
+inline unsigned long long hashBytes(const void* data, size_t size, unsigned long long seed = 14695981039346656037ULL) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	unsigned long long hash = seed;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+template <typename T>
+inline unsigned long long hashValue(const T& value, unsigned long long seed = 14695981039346656037ULL) {
+	return hashBytes(&value, sizeof(T), seed);
+}
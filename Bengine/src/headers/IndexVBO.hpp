@@ -1,8 +1,57 @@
+#pragma once
+
 #include <vector>
 
+// A piece of a split mesh. Its indices are 16-bit and relative to baseVertex,
+// so it is drawn with glDrawElementsBaseVertex.
+struct IndexChunk {
+	unsigned int firstIndex = 0;
+	unsigned int indexCount = 0;
+	int baseVertex = 0;
+};
+
+// Triangle indices for one mesh. Stored 16-bit when every index fits, 32-bit otherwise.
+struct IndexBuffer {
+	std::vector<unsigned short> indices16;
+	std::vector<unsigned int> indices32;
+	bool wide = false;
+	std::vector<IndexChunk> chunks; // empty unless the mesh was split with splitIndexBuffer
+
+	size_t size() const { return wide ? indices32.size() : indices16.size(); }
+	unsigned int operator[](size_t i) const { return wide ? indices32[i] : indices16[i]; }
+	size_t indexSize() const { return wide ? sizeof(unsigned int) : sizeof(unsigned short); }
+	size_t byteSize() const { return size() * indexSize(); }
+	const void* data() const;
+
+	// Stores indices, narrowing to 16-bit if vertexCount allows it.
+	void assign(const std::vector<unsigned int>& indices, size_t vertexCount);
+	// Copies the indices out as 32-bit, whatever the storage width.
+	void widen(std::vector<unsigned int>& out_indices) const;
+	void clear();
+};
+
+// Welds vertices that are within tolerance on every component, using a spatial
+// hash on position so indexing scales linearly with vertex count.
 void indexVBO(
+	std::vector<float>& in_vbo,
+	IndexBuffer& out_ebo,
+	std::vector<float>& out_vbo,
+	int vertex_size
+);
+
+// Reference implementation that scans every output vertex, O(n^2). Kept for benchmarking.
+void indexVBOLinear(
 	std::vector<float>& in_vbo,
 	std::vector<unsigned short>& out_ebo,
 	std::vector<float>& out_vbo,
 	int vertex_size
-);
\ No newline at end of file
+);
+
+// Cuts a mesh with more than maxChunkVertices vertices into chunks that each fit 16-bit indices.
+// Vertices are reordered so every chunk's vertices are contiguous; vertices shared by chunks are duplicated.
+void splitIndexBuffer(
+	std::vector<float>& vbo,
+	IndexBuffer& ebo,
+	int vertex_size,
+	unsigned int maxChunkVertices = 65536
+);
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "LinearMath/btThreads.h"
+
+// Counts the jobs of a batch that have not finished yet. Wait on it to join the batch, or hand it to
+// RunAfter to start more work once it drains. A counter must be waited on before it goes away.
+class JobCounter {
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool Done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	struct Continuation {
+		std::function<void()> task;
+		JobCounter* counter;
+	};
+
+	std::atomic<unsigned int> pending{ 0 };
+	std::mutex mutex; // held while a job reports, so a waiter can't return while it is still in here
+	std::condition_variable drained;
+	std::vector<Continuation> continuations;
+};
+
+// The engine's one thread pool. Every worker owns a deque: it pushes and pops its own jobs at the back and,
+// once that runs dry, steals from the front of the others', so work spreads out while each worker stays on
+// what it queued last, which is still in its cache. Threads outside the pool queue into a shared deque the
+// workers steal from. A worker waiting on a counter runs jobs meanwhile, so jobs can wait on jobs without
+// deadlocking; other threads sleep, which keeps them from picking up work that isn't theirs.
+// It is also Bullet's task scheduler (btSetTaskScheduler), so the physics' parallel loops share the workers.
+class JobSystem : public btITaskScheduler {
+public:
+	// workerCount 0 uses one worker per hardware core but one, leaving that core to the thread that feeds them.
+	explicit JobSystem(unsigned int workerCount = 0);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// Queues task. counter, if given, counts it until it has finished.
+	void Run(std::function<void()> task, JobCounter* counter = nullptr);
+	// Queues task once dependency has drained; right away if it already has.
+	void RunAfter(JobCounter& dependency, std::function<void()> task, JobCounter* counter = nullptr);
+	// Returns once counter has drained. Workers run queued jobs meanwhile.
+	void Wait(JobCounter& counter);
+
+	// Calls body(first, last) over [begin, end) in ranges of grainSize and returns once all of them have run.
+	// The calling thread takes ranges too, alongside at most one job per worker.
+	template <typename Body>
+	void ParallelFor(size_t begin, size_t end, size_t grainSize, const Body& body) {
+		ParallelFor(begin, end, grainSize, &InvokeRange<Body>, &body);
+	}
+
+	unsigned int ThreadCount() const { return (unsigned int)threads.size(); }
+	// 1 and up on the workers, in the order they were started; 0 on any other thread.
+	static unsigned int ThreadIndex();
+
+	// btITaskScheduler
+	int getMaxNumThreads() const override;
+	int getNumThreads() const override;
+	void setNumThreads(int) override {} // the pool is sized once, for the whole engine
+	void parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body) override;
+	btScalar parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body) override;
+
+private:
+	typedef void (*RangeFunction)(const void* context, size_t begin, size_t end);
+
+	// A ParallelFor's ranges; everyone working on it takes the next one until none are left.
+	struct RangeBatch {
+		RangeFunction range;
+		const void* context;
+		size_t end;
+		size_t grainSize;
+		std::atomic<size_t> next;
+	};
+
+	struct Job {
+		std::function<void()> task; // either a task...
+		RangeBatch* batch = nullptr; // ...or a hand in a ParallelFor
+		JobCounter* counter = nullptr;
+	};
+
+	// A deque as a ring buffer that only ever grows, so queueing doesn't allocate once it is warm.
+	struct Queue {
+		std::mutex mutex;
+		std::vector<Job> ring; // size is a power of two
+		size_t head = 0;
+		size_t count = 0;
+
+		void PushBack(Job&& job);
+		bool PopBack(Job& out_job);
+		bool PopFront(Job& out_job);
+	};
+
+	template <typename Body>
+	static void InvokeRange(const void* context, size_t begin, size_t end) {
+		(*(const Body*)context)(begin, end);
+	}
+
+	void ParallelFor(size_t begin, size_t end, size_t grainSize, RangeFunction range, const void* context);
+	static void RunRanges(RangeBatch& batch);
+	void Push(Job&& job);
+	bool TryRunOne();
+	void Execute(Job& job);
+	void Finish(JobCounter* counter);
+	void WorkerLoop(unsigned int index);
+
+	std::vector<std::thread> threads;
+	std::vector<std::unique_ptr<Queue>> queues; // one per worker, then the shared one for outside threads
+	std::atomic<unsigned int> queuedJobs{ 0 };
+	std::atomic<unsigned int> sleepingWorkers{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable jobAvailable;
+	std::atomic<bool> stopping{ false };
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+
+#include "FrameArena.hpp"
+
+struct PointLight {
+	glm::vec3 position; // world space
+	float radius; // no light reaches past this, see pointLightRadius
+	glm::vec3 color;
+	float intensity;
+};
+
+// Distance at which intensity / distance^2 falls to cutoff. The shader fades the light out to zero there.
+inline float pointLightRadius(float intensity, float cutoff = 0.01f) {
+	return sqrtf(intensity / cutoff);
+}
+
+/// <summary>
+/// Bins point lights into a froxel grid: screen tiles by exponential depth slices of the view frustum.
+/// Each light is tested against the view space boxes of the clusters in its depth range, four at a time.
+/// The result is a (first, count) pair per cluster into one flat list of light indices, which the fragment
+/// shader walks for the cluster it falls in. Nothing in here touches GL.
+/// </summary>
+class LightGrid {
+public:
+	static const unsigned int TILES_X = 16; // a multiple of 4 so rows split evenly into SSE lanes
+	static const unsigned int TILES_Y = 9;
+	static const unsigned int SLICES = 24;
+	static const unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+	// Recomputes the cluster bounds if the projection changed since the last call.
+	void SetProjection(float fovY, float aspect, float nearPlane, float farPlane);
+
+	// scratch holds the sort's temporaries; they are dead once Build returns.
+	void Build(const std::vector<PointLight>& lights, const glm::mat4& view, LinearArena& scratch);
+
+	// Cluster index = (slice * TILES_Y + tileY) * TILES_X + tileX; two entries, first and count, per cluster.
+	const std::vector<unsigned int>& Clusters() const { return clusters; }
+	const std::vector<unsigned short>& LightIndices() const { return lightIndices; }
+
+	// slice = floor(log(depth) * SliceScale() + SliceBias()) for a positive view space depth.
+	float SliceScale() const { return sliceScale; }
+	float SliceBias() const { return sliceBias; }
+
+	// View space bounds of a cluster, for testing against.
+	glm::vec3 ClusterMin(unsigned int cluster) const { return glm::vec3(minX[cluster], minY[cluster], minZ[cluster]); }
+	glm::vec3 ClusterMax(unsigned int cluster) const { return glm::vec3(maxX[cluster], maxY[cluster], maxZ[cluster]); }
+
+private:
+	float fovY = 0.0f, aspect = 0.0f, nearPlane = 0.0f, farPlane = 0.0f;
+	float sliceScale = 0.0f, sliceBias = 0.0f;
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+	std::vector<unsigned int> clusters;
+	std::vector<unsigned short> lightIndices;
+	std::vector<unsigned int> hitClusters; // (cluster, light) pairs from the tests, before the counting sort
+	std::vector<unsigned short> hitLights;
+};
+
+// The grid and the lights as texture buffers, since GL 3.3 has no storage buffers:
+// cluster ranges (RG32UI), light indices (R16UI) and two RGBA32F texels per light,
+// position and radius then color times intensity.
+class LightGridTextures {
+public:
+	void Create();
+	// Replaces last frame's contents; the old storage is orphaned rather than waited on.
+	void Upload(const LightGrid& grid, const std::vector<PointLight>& lights);
+	// Binds the three textures to firstUnit, firstUnit + 1 and firstUnit + 2.
+	void Bind(GLuint firstUnit) const;
+	void Destroy();
+
+private:
+	GLuint buffers[3] = { 0, 0, 0 };
+	GLuint textures[3] = { 0, 0, 0 };
+	std::vector<glm::vec4> lightTexels;
+};
@@ -10,23 +10,39 @@
 #include <SOIL.h>
 #include <chrono>
 #include <vector>
+#include <string.h>
 
 #include <gtc/matrix_transform.hpp>
 #include <gtx/transform.hpp>
 #include <gtx/quaternion.hpp>
 #include <gtc/type_ptr.hpp>
 
-#include "Mesh.hpp"
+#include "ObjectPool.hpp"
+#include "Scene.hpp"
+#include "PhysicsBodies.hpp"
 #include "Player.hpp"
 #include "Color.hpp"
 
+#include "GLDebug.hpp"
+#include "ShaderCache.hpp"
 #include "IndexVBO.hpp"
+#include "VertexLayout.hpp"
 #include "OBJLoader.hpp"
+#include "MeshCache.hpp"
+#include "AssetRegistry.hpp"
+#include "RenderQueue.hpp"
+#include "TransformBatch.hpp"
+#include "UniformRing.hpp"
+#include "FrameArena.hpp"
+#include "JobSystem.hpp"
+#include "FrustumCuller.hpp"
+#include "OcclusionBuffer.hpp"
+#include "LightGrid.hpp"
+#include "SimulationThread.hpp"
+#include "Benchmark.hpp"
+#include "SelfTest.hpp"
 
 //physics include
 #include "btBulletDynamicsCommon.h"
-
-#define ASSERT(x) if (!(x)) __debugbreak();
-#define GLCALL(x) GLClearError();\
-    x;\
-    ASSERT(GLLogCall(#x, __FILE__, __LINE__))
\ No newline at end of file
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
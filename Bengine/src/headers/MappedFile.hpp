@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+// Read-only memory mapping of an entire file. The mapping lives as long as the object.
+class MappedFile {
+public:
+	MappedFile() {}
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const char* path);
+	void Close();
+
+	const char* Data() const { return mappedData; }
+	size_t Size() const { return mappedSize; }
+	bool IsOpen() const { return isOpen; }
+
+private:
+	const char* mappedData = nullptr;
+	size_t mappedSize = 0;
+	bool isOpen = false;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <glm.hpp>
+
+#include "IndexVBO.hpp"
+#include "VertexLayout.hpp"
+
+class JobSystem;
+
+// Bump whenever loadOBJ, indexVBO or any other import step changes its output,
+// so stale .bmesh files get rebaked.
+constexpr unsigned int MESH_IMPORTER_VERSION = 4;
+
+// Everything besides the source file that changes the baked result.
+struct MeshImportSettings {
+	VertexLayoutId layout = VertexLayoutId::Compact;
+	glm::vec4 color = glm::vec4(1.0f); // only baked in when the layout has a color attribute
+	bool splitLargeMeshes = false;
+	bool optimizeVertexCache = true; // reorder triangles and vertices for the post-transform cache and fetch
+	bool optimizeOverdraw = true; // then cluster triangles so outward facing ones draw first
+	unsigned int lodCount = 4; // LODs to generate including full detail; meshes that get split keep only full detail
+	float lodReduction = 0.5f; // each LOD aims for this fraction of the previous LOD's triangles
+};
+
+// The one hash and comparison of import settings, shared by the bake cache and the asset registry.
+// A new field in MeshImportSettings goes into both.
+unsigned long long meshSettingsHash(const MeshImportSettings& settings);
+bool operator==(const MeshImportSettings& a, const MeshImportSettings& b);
+
+struct MeshBounds {
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+};
+
+// A level of detail: a range of the mesh's index buffer over the shared vertices.
+// error is how far, in model units, the LOD may deviate from full detail.
+struct MeshLOD {
+	unsigned int firstIndex = 0;
+	unsigned int indexCount = 0;
+	float error = 0.0f;
+};
+
+struct ImportedMesh {
+	std::vector<float> vbo; // import layout, VERTEX_SIZE floats per vertex
+	std::vector<unsigned char> gpuVertices; // the same vertices packed in the settings' VertexLayout
+	IndexBuffer ebo;
+	std::vector<MeshLOD> lods; // lods[0] is full detail, the only one drawn through ebo.chunks
+	MeshBounds bounds;
+};
+
+// Loads an OBJ through its baked .bmesh next to it, one per settings ("models/a.obj" -> "models/a.<settings hash>.bmesh").
+// If the cache is missing or was baked from a different source, importer version or settings,
+// the OBJ is imported and the cache is rewritten, parsing it on jobs if given.
+bool importMesh(const char* objPath, const MeshImportSettings& settings, ImportedMesh& out_mesh, JobSystem* jobs = nullptr);
+
+// Picks the coarsest LOD whose error projects to at most maxPixelError pixels at distance.
+// pixelsPerUnit is the screen height in pixels over the view height at distance 1, viewportHeight / (2 * tan(fovY / 2)).
+unsigned int selectMeshLOD(const ImportedMesh& mesh, float distance, float pixelsPerUnit, float maxPixelError = 1.0f);
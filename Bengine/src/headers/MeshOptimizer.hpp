@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+struct VertexCacheStats {
+	float acmr = 0.0f; // average cache miss ratio: transformed vertices per triangle, 0.5 best, 3 worst
+	float atvr = 0.0f; // average transformed vertex ratio: transformed vertices per vertex, 1 best
+};
+
+// Simulates a FIFO post-transform cache of cacheSize entries over a triangle list.
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = 16);
+
+// Reorders triangles for post-transform cache locality (Forsyth's linear-speed algorithm).
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+// Reorders triangles to draw outward facing clusters first, without giving up much cache locality.
+// Expects the output of optimizeVertexCache. Clusters are split where their ACMR stays within threshold
+// of the cluster's ACMR, then sorted by how far they face out from the mesh center.
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vbo, int vertex_size, float threshold = 1.05f);
+
+// Reorders vertices into the order triangles first use them, so vertex fetch walks memory linearly.
+// Unreferenced vertices are dropped.
+void optimizeVertexFetch(std::vector<unsigned int>& indices, std::vector<float>& vbo, int vertex_size);
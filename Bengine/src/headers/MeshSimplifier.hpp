@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vector>
+
+// Simplifies a triangle list down to about targetIndexCount indices with quadric error metrics.
+// Collapses move a vertex onto one of its neighbours instead of creating new vertices, so the result
+// indexes the same vbo as the input and a LOD chain can share one vertex buffer.
+// Open borders are kept in place. Returns the geometric error of the result in model units.
+float simplifyMesh(
+	const std::vector<unsigned int>& indices,
+	const std::vector<float>& vbo,
+	int vertex_size,
+	size_t targetIndexCount,
+	std::vector<unsigned int>& out_indices
+);
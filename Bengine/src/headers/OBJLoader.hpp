@@ -1,3 +1,24 @@
+#pragma once
+
 #include <vector>
+#include <string>
+
+class JobSystem;
+#include <glm.hpp>
+
+// Floats per vertex in the import layout: position (3), normal (3).
+// Vertices are packed into a VertexLayout for the GPU once importing is done.
+constexpr auto VERTEX_SIZE = 6;
+
+// A named run of vertices in the output of loadOBJ, from a "g" or "o" statement.
+struct OBJGroup {
+	std::string name;
+	size_t firstVertex;
+	size_t vertexCount;
+};
 
-bool loadOBJ(const char* path, std::vector<float>& out_vertices);
\ No newline at end of file
+// Loads a Wavefront OBJ as an unindexed triangle list in the import vertex layout. Accepts v, v/vt, v//vn and v/vt/vn faces, negative indices
+// and polygons (fan triangulated); faces without normals get a flat face normal.
+// The file is memory mapped and large files are parsed in parallel on jobs, or on the calling thread without it.
+bool loadOBJ(const char* path, std::vector<float>& out_vertices,
+	std::vector<OBJGroup>* out_groups = nullptr, JobSystem* jobs = nullptr);
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vector>
+#include <new>
+#include <utility>
+
+#include "LinearMath/btAlignedAllocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// index of the lowest set bit; bits must not be 0
+inline unsigned int lowestSetBit(unsigned long long bits) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return (unsigned int)index;
+#else
+	return (unsigned int)__builtin_ctzll(bits);
+#endif
+}
+
+// Names an object in an ObjectPool<T>. The generation is the slot's at creation; once the object is
+// destroyed the slot's generation moves on and the handle stops resolving.
+template <typename T>
+struct PoolHandle {
+	unsigned int index = 0xFFFFFFFF;
+	unsigned int generation = 0;
+
+	bool Valid() const { return index != 0xFFFFFFFF; }
+};
+
+// Slots for one type, carved out of blocks that stay allocated until the pool goes away, so objects of the
+// type sit together and creating and destroying them after warm-up never touches the heap. Create always
+// takes the lowest free slot, so live objects stay packed toward the front however they were destroyed.
+// Slots are 16-byte aligned for Bullet's SIMD members. Objects never move, so pointers from Get stay
+// good until the object is destroyed.
+template <typename T, unsigned int BLOCK_SLOTS = 256>
+class ObjectPool {
+public:
+	ObjectPool() = default;
+	~ObjectPool() {
+		Clear();
+		for (void* block : blocks)
+			btAlignedFree(block);
+	}
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+
+	template <typename... Args>
+	PoolHandle<T> Create(Args&&... args) {
+		while (firstFreeWord < freeMask.size() && freeMask[firstFreeWord] == 0)
+			firstFreeWord++;
+		if (firstFreeWord == freeMask.size())
+			Grow();
+		unsigned int index = firstFreeWord * 64 + lowestSetBit(freeMask[firstFreeWord]);
+		freeMask[firstFreeWord] &= freeMask[firstFreeWord] - 1;
+		new (Slot(index)) T(std::forward<Args>(args)...);
+		alive[index] = 1;
+		count++;
+
+		PoolHandle<T> handle;
+		handle.index = index;
+		handle.generation = generations[index];
+		return handle;
+	}
+
+	// Stale and invalid handles are ignored.
+	void Destroy(PoolHandle<T> handle) {
+		T* object = Get(handle);
+		if (!object)
+			return;
+		object->~T();
+		alive[handle.index] = 0;
+		generations[handle.index]++;
+		freeMask[handle.index / 64] |= 1ull << (handle.index % 64);
+		if (handle.index / 64 < firstFreeWord)
+			firstFreeWord = handle.index / 64;
+		count--;
+	}
+
+	// nullptr for stale and invalid handles
+	T* Get(PoolHandle<T> handle) const {
+		if (handle.index >= generations.size() || !alive[handle.index] || generations[handle.index] != handle.generation)
+			return nullptr;
+		return Slot(handle.index);
+	}
+
+	// The handle of an object living in this pool, found from its address; an invalid handle otherwise.
+	PoolHandle<T> HandleOf(const T* object) const {
+		PoolHandle<T> handle;
+		for (size_t b = 0; b < blocks.size(); b++) {
+			size_t offset = (const char*)object - (const char*)blocks[b];
+			if (offset < SLOT_SIZE * BLOCK_SLOTS && offset % SLOT_SIZE == 0) {
+				unsigned int index = (unsigned int)(b * BLOCK_SLOTS + offset / SLOT_SIZE);
+				if (alive[index]) {
+					handle.index = index;
+					handle.generation = generations[index];
+				}
+				break;
+			}
+		}
+		return handle;
+	}
+
+	// Destroys every live object; the blocks are kept.
+	void Clear() {
+		for (unsigned int index = 0; index < generations.size(); index++) {
+			if (!alive[index])
+				continue;
+			PoolHandle<T> handle;
+			handle.index = index;
+			handle.generation = generations[index];
+			Destroy(handle);
+		}
+	}
+
+	size_t Count() const { return count; }
+	size_t Capacity() const { return generations.size(); }
+
+private:
+	static const size_t SLOT_SIZE = (sizeof(T) + 15) & ~(size_t)15;
+	static_assert(BLOCK_SLOTS % 64 == 0, "blocks must fill whole words of the free mask");
+
+	T* Slot(unsigned int index) const {
+		return (T*)((char*)blocks[index / BLOCK_SLOTS] + (index % BLOCK_SLOTS) * SLOT_SIZE);
+	}
+
+	void Grow() {
+		unsigned int first = (unsigned int)generations.size();
+		blocks.push_back(btAlignedAlloc(SLOT_SIZE * BLOCK_SLOTS, 16));
+		generations.resize(first + BLOCK_SLOTS, 0);
+		alive.resize(first + BLOCK_SLOTS, 0);
+		freeMask.resize((first + BLOCK_SLOTS) / 64, ~0ull);
+	}
+
+	std::vector<void*> blocks;
+	std::vector<unsigned int> generations;
+	std::vector<unsigned char> alive;
+	std::vector<unsigned long long> freeMask; // a set bit per free slot
+	unsigned int firstFreeWord = 0; // no free slots in the words before this
+	size_t count = 0;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <glm.hpp>
+
+#include "IndexVBO.hpp"
+
+struct OcclusionStats {
+	unsigned int occluderTriangles = 0; // rasterized, after back face and near plane rejection
+	unsigned int tested = 0;
+	unsigned int occluded = 0;
+};
+
+// A low resolution depth buffer that big occluders are rasterized into on the CPU, so occludee
+// bounding boxes can be rejected before submission without reading anything back from the GPU.
+// Depth is NDC z mapped to [0, 1]; empty pixels are 1. Every step errs toward visible:
+// occluder triangles crossing the near plane are skipped, pixels are only written where their
+// center is covered, and a box is tested with its nearest depth over its whole screen rectangle.
+class OcclusionBuffer {
+public:
+	// width is rounded up to a multiple of the tile size.
+	OcclusionBuffer(int width = 256, int height = 144);
+
+	void Clear();
+
+	// Rasterizes the front facing triangles of an indexed mesh. vertices holds vertexStride floats per vertex,
+	// position first; indices in [firstIndex, firstIndex + indexCount) are relative to baseVertex.
+	void RasterizeOccluder(const float* vertices, int vertexStride, const IndexBuffer& indices,
+		unsigned int firstIndex, unsigned int indexCount, int baseVertex, const glm::mat4& mvp);
+
+	// Rebuilds the per tile farthest depth. Call after the last occluder, before testing.
+	void UpdateHierarchy();
+
+	// False only if the world space box is behind occluders everywhere it covers.
+	bool IsVisible(const glm::vec3& min, const glm::vec3& max, const glm::mat4& viewProj);
+
+	int Width() const { return width; }
+	int Height() const { return height; }
+	float Depth(int x, int y) const { return depth[y * width + x]; }
+
+	const OcclusionStats& Stats() const { return stats; }
+	void ResetStats() { stats = OcclusionStats(); }
+
+private:
+	void RasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+
+	int width;
+	int height;
+	int tilesX;
+	int tilesY;
+	std::vector<float> depth;
+	std::vector<float> tileMaxDepth;
+	OcclusionStats stats;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ObjectPool.hpp"
+#include "Scene.hpp"
+#include "btBulletDynamicsCommon.h"
+
+class SimulationThread;
+class FrustumCuller;
+
+// An entity's rigid body and its motion state. The body carries the entity's id as its user index,
+// which is how the simulation's snapshots find the entity's transform.
+struct PhysicsBody {
+	PoolHandle<btRigidBody> body;
+	PoolHandle<btDefaultMotionState> motionState;
+};
+
+// Every motion state, rigid body and constraint the level makes comes out of these, and bodies says which
+// entity owns which body. Like the world, all of it belongs to the simulation thread while that runs,
+// so the render thread reaches it only through SimulationThread::Enqueue.
+struct PhysicsPools {
+	ObjectPool<btDefaultMotionState> motionStates;
+	ObjectPool<btRigidBody> rigidBodies;
+	ObjectPool<btGeneric6DofConstraint> constraints;
+	ComponentArray<PhysicsBody> bodies;
+};
+
+// Makes the entity's body at transform and adds it to the world; mass 0 makes it static.
+// Only whoever owns the world may call this.
+btRigidBody* createPhysicsBody(PhysicsPools& pools, Entity entity, const btTransform& transform, btScalar mass,
+	btCollisionShape* shape, btDiscreteDynamicsWorld* world);
+
+// Takes the entity's body out of the world and back to the pools, along with the constraints attached to it.
+// Does nothing if the entity has no body. Only whoever owns the world may call this.
+void destroyPhysicsBody(PhysicsPools& pools, Entity entity, btDiscreteDynamicsWorld* world);
+
+// Gives the entity its transform right away and a body on the simulation thread before the next step, made
+// from the pools and added to the world there; mass 0 makes it static. The shape must outlive the body.
+void spawnPhysicsBody(Scene& scene, SimulationThread& simulation, PhysicsPools& pools, Entity entity,
+	const btTransform& transform, btScalar mass, btCollisionShape* shape);
+
+// Destroys the entity right away and its body, if it has one, on the simulation thread before the next step.
+// Snapshots taken until then still carry the entity's id, which no longer resolves in the scene.
+// The culler, if given, forgets the entity too, so a recycled index never finds its old bounds there.
+void destroyEntity(Scene& scene, SimulationThread& simulation, PhysicsPools& pools, Entity entity,
+	FrustumCuller* culler = nullptr);
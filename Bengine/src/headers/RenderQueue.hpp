@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <glm.hpp>
+
+#include "JobSystem.hpp"
+
+// Sort key layout, most significant first: pass, program, asset, LOD, depth.
+// Sorting by it groups state changes and draws each group front to back.
+// The top bit is left clear, so no valid key can equal INVALID.
+namespace RenderKey {
+	constexpr int PASS_BITS = 3;
+	constexpr int PROGRAM_BITS = 8;
+	constexpr int ASSET_BITS = 20;
+	constexpr int LOD_BITS = 8;
+	constexpr int DEPTH_BITS = 24;
+
+	constexpr int DEPTH_SHIFT = 0;
+	constexpr int LOD_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+	constexpr int ASSET_SHIFT = LOD_SHIFT + LOD_BITS;
+	constexpr int PROGRAM_SHIFT = ASSET_SHIFT + ASSET_BITS;
+	constexpr int PASS_SHIFT = PROGRAM_SHIFT + PROGRAM_BITS;
+
+	// Commands with this key are dropped, e.g. objects that were culled.
+	constexpr unsigned long long INVALID = ~0ULL;
+
+	// depth is normalized view distance, clamped to [0, 1].
+	unsigned long long Make(unsigned int pass, unsigned int program, unsigned int asset, unsigned int lod, float depth);
+
+	inline unsigned int Pass(unsigned long long key) { return (unsigned int)(key >> PASS_SHIFT) & ((1u << PASS_BITS) - 1); }
+	inline unsigned int Program(unsigned long long key) { return (unsigned int)(key >> PROGRAM_SHIFT) & ((1u << PROGRAM_BITS) - 1); }
+	inline unsigned int Asset(unsigned long long key) { return (unsigned int)(key >> ASSET_SHIFT) & ((1u << ASSET_BITS) - 1); }
+	inline unsigned int Lod(unsigned long long key) { return (unsigned int)(key >> LOD_SHIFT) & ((1u << LOD_BITS) - 1); }
+}
+
+// Per-instance vertex attributes, laid out as the instance buffer stores them.
+// The matrices are precomputed on the CPU, see TransformBatch.
+struct InstanceData {
+	glm::mat4 modelViewProjection;
+	glm::vec4 model[3]; // rows of the affine world transform
+	glm::vec4 normal[3]; // rows of the world normal matrix, w unused
+	glm::vec4 viewDepth; // dot with the local position (w = 1) gives the distance in front of the camera
+	glm::vec4 color;
+};
+
+// std140 uniform blocks, as declared in the shaders. A float after a vec3 fills its padding.
+struct FrameUniforms {
+	glm::mat4 view;
+	glm::mat4 proj;
+	glm::vec4 cameraPosition;
+	glm::vec4 clusterScale; // xy: log view depth to slice, zw: fragment coordinate to tile
+	glm::uvec4 clusterCount;
+};
+
+struct DrawUniforms {
+	glm::vec3 positionOffset;
+	float padding0;
+	glm::vec3 positionScale;
+	float padding1;
+};
+
+// A run of sorted commands that share pass, program, asset and LOD, drawn with one instanced call.
+struct InstanceGroup {
+	unsigned int pass;
+	unsigned int program;
+	unsigned int assetIndex;
+	unsigned int lod;
+	unsigned int firstInstance;
+	unsigned int instanceCount;
+};
+
+// Collects a frame's draws as compact keyed commands, sorts them and groups them for instanced submission.
+// Nothing in here touches GL, so it can be built on worker threads and benchmarked without a context.
+class RenderQueue {
+public:
+	// Fills one command per object. extract returns the command's key and fills its instance,
+	// or returns RenderKey::INVALID to skip the object. It runs on the job system's threads, in batches
+	// of consecutive objects, so it must only write to its own output.
+	typedef std::function<unsigned long long(size_t object, InstanceData& out_instance)> Extractor;
+	void Build(JobSystem& jobs, size_t objectCount, const Extractor& extract);
+
+	// Same as Build, on the calling thread.
+	void BuildSerial(size_t objectCount, const Extractor& extract);
+
+	// Radix sorts the commands by key, drops invalid ones and builds the instance groups.
+	void Sort();
+
+	size_t CommandCount() const { return commands.size(); }
+	unsigned long long Key(size_t i) const { return commands[i].key; }
+
+	const std::vector<InstanceData>& Instances() const { return instances; }
+	const std::vector<InstanceGroup>& Groups() const { return groups; }
+
+private:
+	struct Command {
+		unsigned long long key;
+		unsigned int object;
+		unsigned int padding;
+	};
+
+	void ExtractRange(size_t begin, size_t end, const Extractor& extract);
+
+	std::vector<Command> commands;
+	std::vector<Command> scratch;
+	std::vector<InstanceData> extracted; // indexed by object
+	std::vector<InstanceData> instances; // in sorted order
+	std::vector<InstanceGroup> groups;
+};
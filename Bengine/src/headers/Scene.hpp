@@ -0,0 +1,134 @@
+#pragma once
+
+#include <vector>
+#include <glm.hpp>
+
+#include "LinearMath/btTransform.h"
+
+// Names an entity: its slot in the low bits and the slot's generation in the high ones, so a handle to a
+// destroyed entity stops matching once the slot is reused. Fits a Bullet user index.
+struct Entity {
+	static const unsigned int INDEX_BITS = 22;
+	static const unsigned int INDEX_MASK = (1u << INDEX_BITS) - 1;
+	static const unsigned int INVALID_ID = 0xFFFFFFFF;
+
+	unsigned int id = INVALID_ID;
+
+	unsigned int Index() const { return id & INDEX_MASK; }
+	unsigned int Generation() const { return id >> INDEX_BITS; }
+	bool Valid() const { return id != INVALID_ID; }
+	bool operator==(const Entity& other) const { return id == other.id; }
+	bool operator!=(const Entity& other) const { return id != other.id; }
+};
+
+// One component type for any number of entities. Components are packed densely, so systems walk them
+// in order with At and EntityAt; a table from entity slot to dense position serves lookups by entity.
+// Removing moves the last component into the hole.
+template <typename T>
+class ComponentArray {
+public:
+	T& Add(Entity entity, const T& component = T()) {
+		unsigned int index = entity.Index();
+		if (index >= sparse.size())
+			sparse.resize(index + 1, NONE);
+		if (sparse[index] != NONE) {
+			dense[sparse[index]] = component;
+			entities[sparse[index]] = entity;
+			return dense[sparse[index]];
+		}
+		sparse[index] = (unsigned int)dense.size();
+		dense.push_back(component);
+		entities.push_back(entity);
+		return dense.back();
+	}
+
+	void Remove(Entity entity) {
+		unsigned int index = entity.Index();
+		if (index >= sparse.size() || sparse[index] == NONE)
+			return;
+		unsigned int hole = sparse[index];
+		unsigned int last = (unsigned int)dense.size() - 1;
+		if (hole != last) {
+			dense[hole] = dense[last];
+			entities[hole] = entities[last];
+			sparse[entities[hole].Index()] = hole;
+		}
+		dense.pop_back();
+		entities.pop_back();
+		sparse[index] = NONE;
+	}
+
+	bool Has(Entity entity) const { return Find(entity) != nullptr; }
+
+	T* Find(Entity entity) {
+		unsigned int i = DenseIndex(entity);
+		return i == NONE ? nullptr : &dense[i];
+	}
+	const T* Find(Entity entity) const {
+		unsigned int i = DenseIndex(entity);
+		return i == NONE ? nullptr : &dense[i];
+	}
+
+	// entity must have the component
+	T& Get(Entity entity) { return dense[sparse[entity.Index()]]; }
+	const T& Get(Entity entity) const { return dense[sparse[entity.Index()]]; }
+
+	size_t Size() const { return dense.size(); }
+	T& At(size_t i) { return dense[i]; }
+	const T& At(size_t i) const { return dense[i]; }
+	Entity EntityAt(size_t i) const { return entities[i]; }
+
+private:
+	enum : unsigned int { NONE = 0xFFFFFFFF };
+
+	unsigned int DenseIndex(Entity entity) const {
+		unsigned int index = entity.Index();
+		if (index >= sparse.size() || sparse[index] == NONE || entities[sparse[index]] != entity)
+			return NONE;
+		return sparse[index];
+	}
+
+	std::vector<T> dense;
+	std::vector<Entity> entities; // owner of each dense component
+	std::vector<unsigned int> sparse; // entity slot -> dense position, or NONE
+};
+
+struct RenderMesh {
+	unsigned int meshIndex = 0; // which model file
+	unsigned int assetIndex = 0; // index into the AssetRegistry
+	bool isOccluder = false; // rasterized into the occlusion buffer; its asset must keep its CPU geometry
+	bool isStatic = false; // never moves, so it is culled through the culler's tree
+};
+
+struct Material {
+	glm::vec4 color;
+};
+
+// Entities and their components. Everything in it belongs to the render thread; physics reaches it only
+// through the simulation's snapshots, keyed by the entity ids the bodies carry. The bodies themselves
+// belong to the simulation, see PhysicsPools.
+class Scene {
+public:
+	Entity Create(const char* name = "");
+	// Drops the entity and every component it has. An entity that may have a body goes through
+	// destroyEntity instead, which takes the body out of the world on the simulation thread and the entity
+	// out of the frustum culler.
+	void Destroy(Entity entity);
+	bool IsAlive(Entity entity) const;
+
+	// the live entity in a slot, for systems that only kept its index
+	Entity EntityAt(unsigned int index) const;
+	const char* Name(Entity entity) const { return names[entity.Index()]; }
+	size_t Count() const { return aliveCount; }
+
+	ComponentArray<btTransform> transforms;
+	ComponentArray<RenderMesh> renderMeshes;
+	ComponentArray<Material> materials;
+
+private:
+	std::vector<unsigned int> generations;
+	std::vector<unsigned char> alive;
+	std::vector<const char*> names;
+	std::vector<unsigned int> freeSlots;
+	size_t aliveCount = 0;
+};
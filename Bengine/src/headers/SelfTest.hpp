@@ -0,0 +1,6 @@
+#pragma once
+
+// Runs the engine's CPU-side correctness checks, prints every one that fails and returns how many did,
+// so the result can be the process's exit code. No window or GL context is needed.
+// Launch with "Bengine.exe --selftest".
+int RunSelfTests();
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glew.h>
+
+// One permutation of a vertex + fragment program. Each define ("NAME" or "NAME VALUE") becomes
+// a #define line right after the sources' #version.
+struct ShaderProgramDesc {
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::vector<std::string> defines;
+};
+
+// Builds the program, from the linked binary cached next to the vertex shader when the driver supports
+// program binaries. The cache is keyed by the preprocessed sources, GL_RENDERER and GL_VERSION; a miss or a
+// binary the driver rejects falls back to compiling from source and rewrites the cache.
+// Returns 0 if the sources don't compile or link.
+GLuint loadShaderProgram(const ShaderProgramDesc& desc);
+
+// The source with desc's defines inserted, as it is compiled and hashed.
+bool readShaderSource(const std::string& path, const std::vector<std::string>& defines, std::string& out_source);
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <glm.hpp>
+
+#include "TripleBuffer.hpp"
+#include "btBulletDynamicsCommon.h"
+
+// What the render thread hands the simulation each frame. The simulation uses the newest one on every tick.
+struct SimulationInput {
+	glm::vec3 front{ 0, 0, 1 };
+	glm::vec3 right{ 1, 0, 0 };
+	glm::vec3 up{ 0, 1, 0 };
+	glm::vec3 move{ 0, 0, 0 }; // held movement keys along right, up and front, each -1..1
+	bool leftArm = false;
+	bool rightArm = false;
+	bool paused = false;
+};
+
+// What the simulation hands back besides poses: state the step callback works out that the render thread
+// needs too. The callback fills every field on every tick.
+struct SimulationOutput {
+	float leftArmExtend = 0.0f;
+	float rightArmExtend = 0.0f;
+	bool grounded = false;
+};
+
+struct BodyPose {
+	btVector3 origin;
+	btQuaternion rotation;
+};
+
+// Every collision object's pose before and after a tick, with the user index it carries to say what it
+// belongs to. Carrying both poses keeps interpolation right when the renderer skips a snapshot, and
+// the owners keep it right when objects come and go, which reorders the world's object array.
+struct TransformSnapshot {
+	std::vector<int> owners;
+	std::vector<BodyPose> previous;
+	std::vector<BodyPose> current;
+	SimulationOutput output; // as of current
+	double time = 0.0; // seconds since Start() at which current was due
+};
+
+btTransform interpolatePose(const BodyPose& from, const BodyPose& to, float t);
+
+// Steps a dynamics world at a fixed rate on its own thread. Once started, only the simulation thread may
+// touch the world; the render thread talks to it through SetInput and Enqueue and reads poses back through Latest.
+class SimulationThread {
+public:
+	// Runs on the simulation thread before every step, with the newest input and the tick length.
+	// What it writes to out_output is published with the poses after the step.
+	typedef std::function<void(const SimulationInput& input, float dt, SimulationOutput& out_output)> StepCallback;
+	// Changes the world, e.g. adds or removes bodies.
+	typedef std::function<void(btDiscreteDynamicsWorld* world)> Command;
+
+	SimulationThread(btDiscreteDynamicsWorld* world, float tickSeconds, StepCallback beforeStep);
+	~SimulationThread();
+	SimulationThread(const SimulationThread&) = delete;
+	SimulationThread& operator=(const SimulationThread&) = delete;
+
+	void Start();
+	void Stop();
+
+	void SetInput(const SimulationInput& input);
+
+	// Runs command on the simulation thread before its next step, after everything queued before it,
+	// even while paused. While the simulation isn't running it runs right away on the calling thread,
+	// which must be the one that starts and stops it.
+	void Enqueue(Command command);
+
+	// Newest snapshot, and how far the present lies between its previous (0) and current (1) poses.
+	// Rendering one tick behind the simulation keeps that fraction inside the pair.
+	const TransformSnapshot& Latest(float& out_alpha);
+
+	float TickSeconds() const { return tickSeconds; }
+	float StepMilliseconds() const { return stepMilliseconds.load(std::memory_order_relaxed); }
+	unsigned int DroppedTicks() const { return droppedTicks.load(std::memory_order_relaxed); }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	void Run();
+	void RunCommands();
+	void Capture(std::vector<BodyPose>& out_poses, std::vector<int>* out_owners = nullptr) const;
+	double Seconds(Clock::time_point t) const;
+
+	btDiscreteDynamicsWorld* world;
+	float tickSeconds;
+	StepCallback beforeStep;
+
+	TripleBuffer<SimulationInput> inputs;
+	std::mutex commandMutex;
+	std::vector<Command> commands; // queued, under commandMutex
+	std::vector<Command> runningCommands; // being run, on the simulation thread
+	TripleBuffer<TransformSnapshot> snapshots;
+
+	std::thread thread;
+	std::atomic<bool> running{ false };
+	Clock::time_point start;
+
+	std::atomic<float> stepMilliseconds{ 0.0f };
+	std::atomic<unsigned int> droppedTicks{ 0 };
+};
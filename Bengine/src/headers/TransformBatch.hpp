@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <glm.hpp>
+
+#include "LinearMath/btTransform.h"
+#include "RenderQueue.hpp"
+
+/// <summary>
+/// Turns a frame's object transforms into the matrices the shaders take, in one pass over
+/// structure-of-arrays storage, four objects per SSE instruction. Inputs are read straight from
+/// btTransform's basis and origin, so there is no quaternion round trip and no 4x4 model matrix
+/// multiply. Outputs per object: the affine model matrix, model-view, model-view-projection and
+/// the normal matrix (inverse transpose of the model basis).
+/// </summary>
+class TransformBatch {
+public:
+	// Sets the number of objects. Storage is padded to a multiple of four.
+	void Resize(size_t count);
+	size_t Count() const { return count; }
+
+	void Set(size_t object, const btTransform& transform);
+
+	// Computes every object's matrices for this view and projection.
+	void Compute(const glm::mat4& view, const glm::mat4& proj);
+
+	// Gathers one object's matrices into its instance; color is left alone.
+	void GetInstance(size_t object, InstanceData& out_instance) const;
+
+	glm::mat4 Model(size_t object) const;
+	glm::mat4 ModelView(size_t object) const;
+	glm::mat4 ModelViewProjection(size_t object) const;
+	glm::mat3 Normal(size_t object) const;
+
+private:
+	size_t count = 0;
+	size_t padded = 0;
+	// each array holds one matrix element for every object; rows are listed first
+	std::vector<float> model[12]; // 3x4 affine, row major
+	std::vector<float> modelView[12]; // the bottom row of an affine model-view is always 0 0 0 1
+	std::vector<float> modelViewProjection[16];
+	std::vector<float> normal[9];
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+
+// Hands values from one writer thread to one reader thread without locks. The writer fills its own slot and
+// swaps it into the middle; the reader swaps the middle out when it holds something new. Neither side ever
+// waits, and the reader always sees a complete value, skipping any it was too slow to pick up.
+template <typename T>
+class TripleBuffer {
+public:
+	// writer side
+	T& WriteSlot() { return slots[back]; }
+	void Publish() {
+		back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	// reader side: returns true if a newer value was published since the last call
+	bool Update() {
+		if (!(middle.load(std::memory_order_relaxed) & FRESH))
+			return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+	const T& ReadSlot() const { return slots[front]; }
+
+private:
+	static const unsigned int INDEX = 3;
+	static const unsigned int FRESH = 4;
+
+	T slots[3];
+	std::atomic<unsigned int> middle{ 1 };
+	unsigned int back = 0;
+	unsigned int front = 2;
+};
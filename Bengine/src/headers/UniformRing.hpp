@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+#include <glew.h>
+
+// A buffer for data written once per frame (uniform blocks, instance attributes), split into one partition
+// per frame in flight. A fence after each frame's draws guards its partition, so by the time the ring comes
+// back around the GPU has long finished with it and writing never waits.
+// With ARB_buffer_storage the whole buffer stays mapped, persistent and coherent, for its lifetime; otherwise
+// each frame maps its own partition unsynchronized, which is safe for the same reason.
+class UniformRing {
+public:
+	static const unsigned int FRAMES_IN_FLIGHT = 3;
+	// The offset Allocate and Push return when the partition is full; skip whatever would have read it.
+	static const size_t OVERFLOWED = ~(size_t)0;
+
+	UniformRing() = default;
+	UniformRing(const UniformRing&) = delete;
+	UniformRing& operator=(const UniformRing&) = delete;
+
+	void Create(size_t bytesPerFrame);
+	// Deletes the buffer. Needs the context, so call it before the window goes away.
+	void Destroy();
+
+	// Starts writing the next partition. If bytes (see AlignedSize) won't fit, waits for the GPU once and
+	// regrows every partition.
+	void BeginFrame(size_t bytes);
+
+	// Room for size bytes in this frame's partition, aligned for glBindBufferRange.
+	// Returns the offset into Buffer() and where to write it. If BeginFrame was told too little and the partition
+	// is full, returns OVERFLOWED and throwaway memory to write to, and the next BeginFrame grows the ring.
+	size_t Allocate(size_t size, void** out_data);
+
+	template <typename T>
+	size_t Push(const T& value) {
+		void* data;
+		size_t offset = Allocate(sizeof(T), &data);
+		memcpy(data, &value, sizeof(T));
+		return offset;
+	}
+
+	// Hands this frame's writes to GL. Call after the last write and before the first draw that reads them.
+	void Flush();
+	// Fences the partition. Call after the last draw that reads it.
+	void EndFrame();
+
+	// What an allocation of size bytes takes out of the partition.
+	size_t AlignedSize(size_t size) const { return (size + alignment - 1) / alignment * alignment; }
+
+	GLuint Buffer() const { return buffer; }
+	bool Persistent() const { return persistent; }
+	// Frames that found their partition still in use. Stays 0 unless the GPU falls FRAMES_IN_FLIGHT frames behind.
+	unsigned int Stalls() const { return stalls; }
+
+private:
+	void CreateStorage();
+	void WaitForPartition(unsigned int index);
+
+	GLuint buffer = 0;
+	size_t partitionSize = 0;
+	size_t alignment = 256;
+	bool persistent = false;
+	unsigned char* mapped = nullptr; // the whole buffer when persistent, the current partition when not
+	GLsync fences[FRAMES_IN_FLIGHT] = {};
+	unsigned int partition = 0;
+	size_t used = 0;
+	size_t requested = 0; // this frame's allocations, including any that didn't fit
+	size_t shortfall = 0; // what the last overflowing frame asked for; BeginFrame makes room for it
+	std::vector<unsigned char> overflowScratch;
+	unsigned int stalls = 0;
+};
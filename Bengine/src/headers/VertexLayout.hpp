@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <glm.hpp>
+
+enum class VertexSemantic {
+	Position,
+	Normal,
+	Color
+};
+
+enum class VertexFormat {
+	Float3,       // 3 x 32-bit float
+	Float4,       // 4 x 32-bit float
+	Half4,        // 4 x 16-bit float
+	Snorm16x4,    // position quantized to the mesh bounds, decoded with positionoffset/positionscale
+	OctSnorm16x2, // unit vector in octahedral encoding
+	Unorm8x4      // RGBA8
+};
+
+// Every layout the importer can produce. Stored in caches, so only append.
+enum class VertexLayoutId {
+	Float,        // position float3, normal float3, color float4: 40 bytes
+	Compact,      // position snorm16x4, normal oct16, color per draw: 12 bytes
+	CompactColor, // position snorm16x4, normal oct16, color rgba8: 16 bytes
+	Half          // position half4, normal oct16, color per draw: 12 bytes
+};
+
+struct VertexAttribute {
+	VertexSemantic semantic;
+	VertexFormat format;
+	unsigned int offset;
+};
+
+// Describes how one vertex is laid out in a GPU vertex buffer. The importer packs vertices with it
+// and the renderer sets up glVertexAttribPointer from it. Semantics that are missing from the layout
+// (normally color) are supplied per draw instead.
+struct VertexLayout {
+	VertexLayoutId id;
+	VertexAttribute attributes[3];
+	unsigned int attributeCount;
+	unsigned int stride;
+
+	static VertexLayout Get(VertexLayoutId id);
+	const VertexAttribute* Find(VertexSemantic semantic) const;
+	bool QuantizesPositions() const;
+};
+
+// Components, and whether a format is an integer format the GPU normalizes to [-1, 1] or [0, 1].
+unsigned int vertexFormatComponents(VertexFormat format);
+bool vertexFormatNormalized(VertexFormat format);
+
+// Packs an indexed float vertex stream (position, normal) into layout.
+// Quantized positions are stored relative to the bounds center, scaled by their half extent.
+void packVertices(
+	const std::vector<float>& vbo,
+	int vertex_size,
+	const VertexLayout& layout,
+	glm::vec3 boundsMin,
+	glm::vec3 boundsMax,
+	glm::vec4 color,
+	std::vector<unsigned char>& out_packed
+);
+
+// Offset and scale that turn a decoded position back into mesh space: offset + decoded * scale.
+void vertexPositionDecode(const VertexLayout& layout, glm::vec3 boundsMin, glm::vec3 boundsMax,
+	glm::vec3& out_offset, glm::vec3& out_scale);
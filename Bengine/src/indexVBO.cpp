@@ -2,31 +2,67 @@
 
 #include <glm.hpp>
 #include <vector>
-#include <map>
+#include <unordered_map>
 #include <string.h>
 
+#include "headers/IndexVBO.hpp"
+
+static const float WELD_TOLERANCE = 0.01f;
+
+const void* IndexBuffer::data() const {
+	if (wide)
+		return indices32.empty() ? nullptr : &indices32[0];
+	return indices16.empty() ? nullptr : &indices16[0];
+}
+
+void IndexBuffer::assign(const std::vector<unsigned int>& indices, size_t vertexCount) {
+	clear();
+	wide = vertexCount > 65536;
+	if (wide) {
+		indices32 = indices;
+		return;
+	}
+	indices16.resize(indices.size());
+	for (size_t i = 0; i < indices.size(); i++)
+		indices16[i] = (unsigned short)indices[i];
+}
+
+void IndexBuffer::widen(std::vector<unsigned int>& out_indices) const {
+	if (wide) {
+		out_indices = indices32;
+		return;
+	}
+	out_indices.assign(indices16.begin(), indices16.end());
+}
+
+void IndexBuffer::clear() {
+	indices16.clear();
+	indices32.clear();
+	chunks.clear();
+	wide = false;
+}
+
 bool is_near(float v1, float v2) {
-	return fabs(v1 - v2) < 0.01f;
+	return fabs(v1 - v2) < WELD_TOLERANCE;
+}
+
+static bool is_near_vertex(const float* a, const float* b, int vertex_size) {
+	for (int k = 0; k < vertex_size; k++) {
+		if (!is_near(a[k], b[k]))
+			return false;
+	}
+	return true;
 }
 
 bool getSimilarVertexIndex(
-	std::vector<float> & in_vertex,
+	const float* in_vertex,
 	std::vector<float> & out_vbo,
 	unsigned short & result,
 	int vertex_size
 ) {
 	// Lame linear search
 	for (unsigned int i = 0; i < out_vbo.size() / vertex_size; i++) {
-		if (
-			is_near(in_vertex[0], out_vbo[i * vertex_size]) &&
-			is_near(in_vertex[1], out_vbo[i * vertex_size + 1]) &&
-			is_near(in_vertex[2], out_vbo[i * vertex_size + 2]) &&
-			is_near(in_vertex[3], out_vbo[i * vertex_size + 3]) &&
-			is_near(in_vertex[4], out_vbo[i * vertex_size + 4]) &&
-			is_near(in_vertex[5], out_vbo[i * vertex_size + 5]) //&&
-			//is_near(in_vertex[6], out_vbo[i * vertex_size + 6]) &&
-			//is_near(in_vertex[7], out_vbo[i * vertex_size + 7])
-			) {
+		if (is_near_vertex(in_vertex, &out_vbo[i * vertex_size], vertex_size)) {
 			result = i;
 			return true;
 		}
@@ -36,7 +72,7 @@ bool getSimilarVertexIndex(
 	return false;
 }
 
-void indexVBO(
+void indexVBOLinear(
 	std::vector<float>& in_vbo,
 	std::vector<unsigned short>& out_ebo,
 	std::vector<float>& out_vbo,
@@ -45,13 +81,7 @@ void indexVBO(
 	// For each input vertex
 	for (unsigned int i = 0; i < in_vbo.size() / vertex_size; i++) {
 
-		unsigned int vertex_start = i * vertex_size;
-		unsigned int vertex_end = i * vertex_size + vertex_size;
-		std::vector<float> vertex;
-
-		for (unsigned int j = vertex_start; j < vertex_end; j++) {
-			vertex.push_back(in_vbo[j]);
-		}
+		const float* vertex = &in_vbo[i * vertex_size];
 
 		unsigned short index;
 		bool found = getSimilarVertexIndex(vertex, out_vbo, index, vertex_size);
@@ -60,11 +90,149 @@ void indexVBO(
 			out_ebo.push_back(index);
 		}
 		else { // If not, it needs to be added in the output data.
-			for (unsigned int j = 0; j < vertex.size(); j++)
-				out_vbo.push_back(vertex[j]);
+			out_vbo.insert(out_vbo.end(), vertex, vertex + vertex_size);
 
-			unsigned short new_index = (unsigned short)out_vbo.size() / vertex_size - 1;
+			unsigned short new_index = (unsigned short)(out_vbo.size() / vertex_size - 1);
 			out_ebo.push_back(new_index);
 		}
 	}
-}
\ No newline at end of file
+}
+
+// Cells are one tolerance wide, so any vertex within tolerance of a query lies in
+// the query's cell or one of its 26 neighbours.
+static long long cellKey(int x, int y, int z) {
+	return ((long long)(x & 0x1FFFFF) << 42) | ((long long)(y & 0x1FFFFF) << 21) | (long long)(z & 0x1FFFFF);
+}
+
+static int cellCoord(float v) {
+	return (int)floor(v / WELD_TOLERANCE);
+}
+
+void indexVBO(
+	std::vector<float>& in_vbo,
+	IndexBuffer& out_ebo,
+	std::vector<float>& out_vbo,
+	int vertex_size) {
+
+	const unsigned int vertexCount = in_vbo.size() / vertex_size;
+	std::vector<unsigned int> indices;
+	indices.reserve(vertexCount);
+
+	// grid cell -> most recently added vertex in that cell, chained through cellNext
+	std::unordered_map<long long, unsigned int> cellHead;
+	std::vector<unsigned int> cellNext;
+	const unsigned int END = 0xFFFFFFFF;
+
+	cellHead.reserve(vertexCount);
+	cellNext.reserve(vertexCount);
+	out_vbo.reserve(out_vbo.size() + in_vbo.size());
+
+	auto addToGrid = [&](unsigned int index, int cx, int cy, int cz) {
+		auto head = cellHead.emplace(cellKey(cx, cy, cz), END).first;
+		cellNext.push_back(head->second);
+		head->second = index;
+	};
+
+	// vertices already in out_vbo are candidates too, same as in the linear scan
+	for (unsigned int i = 0; i < out_vbo.size() / vertex_size; i++) {
+		const float* vertex = &out_vbo[i * vertex_size];
+		addToGrid(i, cellCoord(vertex[0]), cellCoord(vertex[1]), cellCoord(vertex[2]));
+	}
+
+	for (unsigned int i = 0; i < vertexCount; i++) {
+		const float* vertex = &in_vbo[i * vertex_size];
+		int cx = cellCoord(vertex[0]);
+		int cy = cellCoord(vertex[1]);
+		int cz = cellCoord(vertex[2]);
+
+		// The linear scan returns the first match, so keep the lowest matching index.
+		unsigned int found = END;
+		for (int dx = -1; dx <= 1; dx++) {
+			for (int dy = -1; dy <= 1; dy++) {
+				for (int dz = -1; dz <= 1; dz++) {
+					auto cell = cellHead.find(cellKey(cx + dx, cy + dy, cz + dz));
+					if (cell == cellHead.end())
+						continue;
+					for (unsigned int j = cell->second; j != END; j = cellNext[j]) {
+						if (j < found && is_near_vertex(vertex, &out_vbo[j * vertex_size], vertex_size))
+							found = j;
+					}
+				}
+			}
+		}
+
+		if (found != END) {
+			indices.push_back(found);
+			continue;
+		}
+
+		unsigned int new_index = out_vbo.size() / vertex_size;
+		out_vbo.insert(out_vbo.end(), vertex, vertex + vertex_size);
+		indices.push_back(new_index);
+		addToGrid(new_index, cx, cy, cz);
+	}
+
+	out_ebo.assign(indices, out_vbo.size() / vertex_size);
+}
+
+void splitIndexBuffer(
+	std::vector<float>& vbo,
+	IndexBuffer& ebo,
+	int vertex_size,
+	unsigned int maxChunkVertices) {
+
+	const size_t vertexCount = vbo.size() / vertex_size;
+	if (vertexCount <= maxChunkVertices)
+		return;
+
+	const unsigned int UNMAPPED = 0xFFFFFFFF;
+	std::vector<float> chunkedVbo;
+	std::vector<unsigned short> chunkedIndices;
+	std::vector<IndexChunk> chunks;
+	chunkedVbo.reserve(vbo.size());
+	chunkedIndices.reserve(ebo.size());
+
+	// source vertex -> index inside the current chunk
+	std::vector<unsigned int> localIndex(vertexCount, UNMAPPED);
+	std::vector<unsigned int> chunkVertices; // source vertices of the current chunk, for resetting localIndex
+
+	IndexChunk chunk;
+	auto finishChunk = [&]() {
+		chunk.indexCount = (unsigned int)chunkedIndices.size() - chunk.firstIndex;
+		if (chunk.indexCount > 0)
+			chunks.push_back(chunk);
+		for (unsigned int v : chunkVertices)
+			localIndex[v] = UNMAPPED;
+		chunkVertices.clear();
+		chunk.firstIndex = (unsigned int)chunkedIndices.size();
+		chunk.baseVertex = (int)(chunkedVbo.size() / vertex_size);
+	};
+
+	for (size_t i = 0; i + 2 < ebo.size(); i += 3) {
+		unsigned int triangle[3] = { ebo[i], ebo[i + 1], ebo[i + 2] };
+
+		unsigned int newVertices = 0;
+		for (int k = 0; k < 3; k++) {
+			if (localIndex[triangle[k]] == UNMAPPED)
+				newVertices++;
+		}
+		if (chunkVertices.size() + newVertices > maxChunkVertices)
+			finishChunk();
+
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = triangle[k];
+			if (localIndex[v] == UNMAPPED) {
+				localIndex[v] = (unsigned int)chunkVertices.size();
+				chunkVertices.push_back(v);
+				chunkedVbo.insert(chunkedVbo.end(), &vbo[v * vertex_size], &vbo[v * vertex_size] + vertex_size);
+			}
+			chunkedIndices.push_back((unsigned short)localIndex[v]);
+		}
+	}
+	finishChunk();
+
+	vbo.swap(chunkedVbo);
+	ebo.clear();
+	ebo.indices16.swap(chunkedIndices);
+	ebo.chunks.swap(chunks);
+}
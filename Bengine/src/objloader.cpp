@@ -2,167 +2,430 @@
 #include <string>
 #include <glm.hpp>
 #include <iostream>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 
-//bool loadOBJ(const char* path, std::vector<float>& out_vertices) {
-//
-//	std::vector<glm::vec3> out_positions;
-//	std::vector<glm::vec2> out_uvs;
-//	std::vector<glm::vec3> out_normals;
-//	std::vector<unsigned int> positionIndices, uvIndices, normalIndices;
-//	std::vector<glm::vec3> temp_positions;
-//	std::vector<glm::vec2> temp_uvs;
-//	std::vector<glm::vec3> temp_normals;
-//
-//	FILE* file = NULL;
-//	fopen_s(&file, path, "r");
-//	if (file == NULL) {
-//		printf("Couldn't open file");
-//		return false;
-//	}
-//
-//	while (1) {
-//		char lineHeader[256];
-//
-//		int res = fscanf_s(file, "%s", lineHeader, sizeof(lineHeader));
-//		if (res == EOF)
-//			break;
-//
-//		if (strcmp(lineHeader, "v") == 0) {
-//			glm::vec3 vertex;
-//			fscanf_s(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
-//			temp_positions.push_back(vertex);
-//		}
-//		else if (strcmp(lineHeader, "vt") == 0) {
-//			glm::vec2 uv;
-//			fscanf_s(file, "%f %f\n", &uv.x, &uv.y);
-//			temp_uvs.push_back(uv);
-//		}
-//		else if (strcmp(lineHeader, "vn") == 0) {
-//			glm::vec3 normal;
-//			fscanf_s(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
-//			temp_normals.push_back(normal);
-//		}
-//		else if (strcmp(lineHeader, "f") == 0) {
-//			std::string pos1, pos2, pos3;
-//			unsigned int positionIndex[3], uvIndex[3], normalIndex[3];
-//			int matches = fscanf_s(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n",
-//				&positionIndex[0], &uvIndex[0], &normalIndex[0],
-//				&positionIndex[1], &uvIndex[1], &normalIndex[1],
-//				&positionIndex[2], &uvIndex[2], &normalIndex[2]);
-//			if (matches != 9) {
-//				printf("File cannot be read by my crappy parser.");
-//				return false;
-//			}
-//			positionIndices.push_back(positionIndex[0]);
-//			positionIndices.push_back(positionIndex[1]);
-//			positionIndices.push_back(positionIndex[2]);
-//			uvIndices.push_back(uvIndex[0]);
-//			uvIndices.push_back(uvIndex[1]);
-//			uvIndices.push_back(uvIndex[2]);
-//			normalIndices.push_back(normalIndex[0]);
-//			normalIndices.push_back(normalIndex[1]);
-//			normalIndices.push_back(normalIndex[2]);
-//		}
-//	}
-//
-//	for (unsigned int i = 0; i < positionIndices.size(); i++) {
-//		unsigned int vertexIndex = positionIndices[i];
-//		glm::vec3 vertex = temp_positions[vertexIndex - 1];
-//		out_positions.push_back(vertex);
-//	}
-//	for (unsigned int i = 0; i < uvIndices.size(); i++) {
-//		unsigned int uvIndex = uvIndices[i];
-//		glm::vec2 uv = temp_uvs[uvIndex - 1];
-//		out_uvs.push_back(uv);
-//	}
-//	for (unsigned int i = 0; i < normalIndices.size(); i++) {
-//		unsigned int normalIndex = normalIndices[i];
-//		glm::vec3 normal = temp_normals[normalIndex - 1];
-//		out_normals.push_back(normal);
-//	}
-//
-//	for (unsigned int i = 0; i < out_positions.size(); i++) {
-//		out_vertices.push_back(out_positions[i].x);
-//		out_vertices.push_back(out_positions[i].y);
-//		out_vertices.push_back(out_positions[i].z);
-//		out_vertices.push_back(out_uvs[i].x);
-//		out_vertices.push_back(out_uvs[i].y);
-//		out_vertices.push_back(out_normals[i].x);
-//		out_vertices.push_back(out_normals[i].y);
-//		out_vertices.push_back(out_normals[i].z);
-//	}
-//	return true;
-//}
-
-bool loadOBJ(const char* path, std::vector<float>& out_vertices) {
-
-	std::vector<glm::vec3> out_positions;
-	std::vector<glm::vec3> out_normals;
-	std::vector<unsigned int> positionIndices, normalIndices;
-	std::vector<glm::vec3> temp_positions;
-	std::vector<glm::vec3> temp_normals;
-
-	FILE* file = NULL;
-	fopen_s(&file, path, "r");
-	if (file == NULL) {
-		printf("Couldn't open file");
-		return false;
+#include "headers/OBJLoader.hpp"
+#include "headers/MappedFile.hpp"
+#include "headers/JobSystem.hpp"
+
+// Files smaller than this are parsed on the calling thread; splitting them up costs more than it saves.
+static const size_t PARALLEL_PARSE_MIN_BYTES = 1 << 20;
+
+static bool isSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* skipSpaces(const char* p, const char* end) {
+	while (p < end && isSpace(*p))
+		p++;
+	return p;
+}
+
+static const char* skipToNextLine(const char* p, const char* end) {
+	while (p < end && *p != '\n')
+		p++;
+	return p < end ? p + 1 : end;
+}
+
+static bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+/// <summary>
+/// Parses a decimal float, accumulating up to 19 significant digits in an integer
+/// and scaling once by a power of ten. Falls back to strtod for anything unusual (inf, nan, hex).
+/// </summary>
+static const char* parseFloat(const char* p, const char* end, float& out) {
+	static const double powersOf10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	p = skipSpaces(p, end);
+	const char* start = p;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	if (p >= end || (!isDigit(*p) && *p != '.')) {
+		char buffer[64];
+		size_t length = 0;
+		while (start + length < end && length < sizeof(buffer) - 1 && !isSpace(start[length]) && start[length] != '\n')
+			length++;
+		memcpy(buffer, start, length);
+		buffer[length] = '\0';
+		char* parsedEnd;
+		out = (float)strtod(buffer, &parsedEnd);
+		return start + (parsedEnd - buffer);
+	}
+
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	while (p < end && isDigit(*p)) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa) digits++;
+		}
+		else {
+			exponent++;
+		}
+		p++;
+	}
+	if (p < end && *p == '.') {
+		p++;
+		while (p < end && isDigit(*p)) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa) digits++;
+				exponent--;
+			}
+			p++;
+		}
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negativeExponent = *p == '-';
+			p++;
+		}
+		int e = 0;
+		while (p < end && isDigit(*p)) {
+			if (e < 10000) e = e * 10 + (*p - '0');
+			p++;
+		}
+		exponent += negativeExponent ? -e : e;
 	}
 
-	while (1) {
-		char lineHeader[256];
+	double value = (double)mantissa;
+	while (exponent > 22) { value *= 1e22; exponent -= 22; }
+	while (exponent < -22) { value /= 1e22; exponent += 22; }
+	value = exponent >= 0 ? value * powersOf10[exponent] : value / powersOf10[-exponent];
+
+	out = (float)(negative ? -value : value);
+	return p;
+}
+
+static const char* parseInt(const char* p, const char* end, int& out, bool& ok) {
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	ok = p < end && isDigit(*p);
+	int value = 0;
+	while (p < end && isDigit(*p)) {
+		value = value * 10 + (*p - '0');
+		p++;
+	}
+	out = negative ? -value : value;
+	return p;
+}
+
+enum class OBJLine {
+	Empty,
+	Position,
+	Normal,
+	Face,
+	Group,
+	Other
+};
+
+// Classifies a line and returns a pointer to the first character after its keyword.
+static OBJLine classifyLine(const char* p, const char* end, const char*& rest) {
+	p = skipSpaces(p, end);
+	rest = p;
+	if (p >= end || *p == '\n' || *p == '#')
+		return OBJLine::Empty;
+
+	const char* keyword = p;
+	while (p < end && !isSpace(*p) && *p != '\n')
+		p++;
+	size_t length = p - keyword;
+	rest = p;
 
-		int res = fscanf_s(file, "%s", lineHeader, sizeof(lineHeader));
-		if (res == EOF)
+	if (length == 1 && keyword[0] == 'v') return OBJLine::Position;
+	if (length == 2 && keyword[0] == 'v' && keyword[1] == 'n') return OBJLine::Normal;
+	if (length == 1 && keyword[0] == 'f') return OBJLine::Face;
+	if (length == 1 && (keyword[0] == 'g' || keyword[0] == 'o')) return OBJLine::Group;
+	return OBJLine::Other;
+}
+
+struct OBJCorner {
+	int position;
+	int normal; // -1 when the face has no normals
+};
+
+/// <summary>
+/// Parses the corners of a face line in any of the forms v, v/vt, v//vn and v/vt/vn,
+/// resolving negative (relative) indices. Returns false on malformed or out of range indices.
+/// </summary>
+static bool parseFace(const char* p, const char* end, int positionsSoFar, int normalsSoFar,
+	int positionCount, int normalCount, std::vector<OBJCorner>& corners) {
+
+	corners.clear();
+	while (true) {
+		p = skipSpaces(p, end);
+		if (p >= end || *p == '\n' || *p == '#')
 			break;
 
-		if (strcmp(lineHeader, "v") == 0) {
-			glm::vec3 vertex;
-			fscanf_s(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
-			temp_positions.push_back(vertex);
-		}	
-		else if (strcmp(lineHeader, "vn") == 0) {
-			glm::vec3 normal;
-			fscanf_s(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
-			temp_normals.push_back(normal);
+		OBJCorner corner = { -1, -1 };
+		int value;
+		bool ok;
+		p = parseInt(p, end, value, ok);
+		if (!ok || value == 0)
+			return false;
+		corner.position = value > 0 ? value - 1 : positionsSoFar + value;
+		if (corner.position < 0 || corner.position >= positionCount)
+			return false;
+
+		if (p < end && *p == '/') {
+			p++;
+			if (p < end && *p != '/') // texture coordinate, not used by the engine
+				p = parseInt(p, end, value, ok);
+			if (p < end && *p == '/') {
+				p++;
+				p = parseInt(p, end, value, ok);
+				if (!ok || value == 0)
+					return false;
+				corner.normal = value > 0 ? value - 1 : normalsSoFar + value;
+				if (corner.normal < 0 || corner.normal >= normalCount)
+					return false;
+			}
 		}
-		else if (strcmp(lineHeader, "f") == 0) {
-			unsigned int positionIndex[3], normalIndex[3];
-			int matches = fscanf_s(file, "%d//%d %d//%d %d//%d\n",
-				&positionIndex[0], &normalIndex[0],
-				&positionIndex[1], &normalIndex[1],
-				&positionIndex[2], &normalIndex[2]);
-			if (matches != 6) {
-				printf("File cannot be read by my crappy parser.");
+		corners.push_back(corner);
+
+		while (p < end && !isSpace(*p) && *p != '\n')
+			p++;
+	}
+	return corners.size() >= 3;
+}
+
+struct OBJGroupStart {
+	std::string name;
+	size_t triangle; // first triangle of the group, local to the chunk until offsets are known
+};
+
+struct OBJChunk {
+	const char* begin;
+	const char* end;
+	size_t positionCount = 0;
+	size_t normalCount = 0;
+	size_t triangleCount = 0;
+	std::vector<OBJGroupStart> groups;
+
+	// global offsets, filled in after counting
+	size_t positionOffset = 0;
+	size_t normalOffset = 0;
+	size_t triangleOffset = 0;
+};
+
+// Pass 1: count what each chunk contributes so every chunk knows where to write.
+static void countChunk(OBJChunk& chunk) {
+	const char* p = chunk.begin;
+	while (p < chunk.end) {
+		const char* rest;
+		OBJLine type = classifyLine(p, chunk.end, rest);
+		if (type == OBJLine::Position) {
+			chunk.positionCount++;
+		}
+		else if (type == OBJLine::Normal) {
+			chunk.normalCount++;
+		}
+		else if (type == OBJLine::Face) {
+			size_t corners = 0;
+			const char* q = skipSpaces(rest, chunk.end);
+			while (q < chunk.end && *q != '\n' && *q != '#') {
+				corners++;
+				while (q < chunk.end && !isSpace(*q) && *q != '\n')
+					q++;
+				q = skipSpaces(q, chunk.end);
+			}
+			if (corners >= 3)
+				chunk.triangleCount += corners - 2;
+		}
+		else if (type == OBJLine::Group) {
+			const char* nameStart = skipSpaces(rest, chunk.end);
+			const char* nameEnd = nameStart;
+			while (nameEnd < chunk.end && *nameEnd != '\n' && *nameEnd != '\r')
+				nameEnd++;
+			chunk.groups.push_back({ std::string(nameStart, nameEnd), chunk.triangleCount });
+		}
+		p = skipToNextLine(rest, chunk.end);
+	}
+}
+
+// Pass 2: parse positions and normals into their global slots.
+static void parseAttributes(const OBJChunk& chunk, std::vector<glm::vec3>& positions, std::vector<glm::vec3>& normals) {
+	size_t position = chunk.positionOffset;
+	size_t normal = chunk.normalOffset;
+	const char* p = chunk.begin;
+	while (p < chunk.end) {
+		const char* rest;
+		OBJLine type = classifyLine(p, chunk.end, rest);
+		if (type == OBJLine::Position || type == OBJLine::Normal) {
+			glm::vec3& v = type == OBJLine::Position ? positions[position++] : normals[normal++];
+			rest = parseFloat(rest, chunk.end, v.x);
+			rest = parseFloat(rest, chunk.end, v.y);
+			rest = parseFloat(rest, chunk.end, v.z);
+		}
+		p = skipToNextLine(rest, chunk.end);
+	}
+}
+
+// Pass 3: triangulate faces and write interleaved vertices straight into the output buffer.
+static bool parseFaces(const OBJChunk& chunk, const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals,
+	float* out) {
+
+	out += chunk.triangleOffset * 3 * VERTEX_SIZE;
+	int positionsSoFar = (int)chunk.positionOffset;
+	int normalsSoFar = (int)chunk.normalOffset;
+	std::vector<OBJCorner> corners;
+
+	const char* p = chunk.begin;
+	while (p < chunk.end) {
+		const char* rest;
+		OBJLine type = classifyLine(p, chunk.end, rest);
+		if (type == OBJLine::Position) {
+			positionsSoFar++;
+		}
+		else if (type == OBJLine::Normal) {
+			normalsSoFar++;
+		}
+		else if (type == OBJLine::Face) {
+			if (!parseFace(rest, chunk.end, positionsSoFar, normalsSoFar, (int)positions.size(), (int)normals.size(), corners))
 				return false;
+
+			// fan triangulation, (0, i, i + 1)
+			for (size_t i = 1; i + 1 < corners.size(); i++) {
+				const OBJCorner* triangle[3] = { &corners[0], &corners[i], &corners[i + 1] };
+				glm::vec3 faceNormal(0.0f);
+				if (triangle[0]->normal < 0 || triangle[1]->normal < 0 || triangle[2]->normal < 0) {
+					const glm::vec3& a = positions[triangle[0]->position];
+					faceNormal = glm::cross(positions[triangle[1]->position] - a, positions[triangle[2]->position] - a);
+					float length = glm::length(faceNormal);
+					faceNormal = length > 0.0f ? faceNormal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+				}
+
+				for (int k = 0; k < 3; k++) {
+					const glm::vec3& position = positions[triangle[k]->position];
+					const glm::vec3& normal = triangle[k]->normal >= 0 ? normals[triangle[k]->normal] : faceNormal;
+					out[0] = position.x;
+					out[1] = position.y;
+					out[2] = position.z;
+					out[3] = normal.x;
+					out[4] = normal.y;
+					out[5] = normal.z;
+					out += VERTEX_SIZE;
+				}
 			}
-			positionIndices.push_back(positionIndex[0]);
-			positionIndices.push_back(positionIndex[1]);
-			positionIndices.push_back(positionIndex[2]);
-			normalIndices.push_back(normalIndex[0]);
-			normalIndices.push_back(normalIndex[1]);
-			normalIndices.push_back(normalIndex[2]);
 		}
+		p = skipToNextLine(rest, chunk.end);
 	}
+	return true;
+}
 
-	for (unsigned int i = 0; i < positionIndices.size(); i++) {
-		unsigned int vertexIndex = positionIndices[i];
-		glm::vec3 vertex = temp_positions[vertexIndex - 1];
-		out_positions.push_back(vertex);
+template <typename Func>
+static void forEachChunk(JobSystem* jobs, std::vector<OBJChunk>& chunks, Func func) {
+	if (!jobs || chunks.size() == 1) {
+		for (OBJChunk& chunk : chunks)
+			func(chunk);
+		return;
 	}
-	for (unsigned int i = 0; i < normalIndices.size(); i++) {
-		unsigned int normalIndex = normalIndices[i];
-		glm::vec3 normal = temp_normals[normalIndex - 1];
-		out_normals.push_back(normal);
+	jobs->ParallelFor(0, chunks.size(), 1, [&func, &chunks](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++)
+			func(chunks[i]);
+	});
+}
+
+bool loadOBJ(const char* path, std::vector<float>& out_vertices,
+	std::vector<OBJGroup>* out_groups, JobSystem* jobs) {
+
+	MappedFile file;
+	if (!file.Open(path)) {
+		printf("Couldn't open file %s\n", path);
+		return false;
 	}
+	const char* begin = file.Data();
+	const char* end = begin + file.Size();
+
+	// a chunk for every thread that can work on it
+	unsigned int threadCount = jobs ? jobs->ThreadCount() + 1 : 1;
+	if (file.Size() < PARALLEL_PARSE_MIN_BYTES)
+		threadCount = 1;
 
-	for (unsigned int i = 0; i < out_positions.size(); i++) {
-		out_vertices.push_back(out_positions[i].x);
-		out_vertices.push_back(out_positions[i].y);
-		out_vertices.push_back(out_positions[i].z);
-		out_vertices.push_back(out_normals[i].x);
-		out_vertices.push_back(out_normals[i].y);
-		out_vertices.push_back(out_normals[i].z);
+	// split into line-aligned chunks
+	std::vector<OBJChunk> chunks;
+	const char* chunkBegin = begin;
+	for (unsigned int i = 0; i < threadCount && chunkBegin < end; i++) {
+		const char* chunkEnd = i + 1 == threadCount ? end : begin + file.Size() / threadCount * (i + 1);
+		if (chunkEnd <= chunkBegin)
+			continue;
+		chunkEnd = skipToNextLine(chunkEnd - 1, end);
+		OBJChunk chunk;
+		chunk.begin = chunkBegin;
+		chunk.end = chunkEnd;
+		chunks.push_back(chunk);
+		chunkBegin = chunkEnd;
+	}
+	if (chunks.empty())
+		return true;
+
+	forEachChunk(jobs, chunks, countChunk);
+
+	size_t positionCount = 0, normalCount = 0, triangleCount = 0;
+	for (OBJChunk& chunk : chunks) {
+		chunk.positionOffset = positionCount;
+		chunk.normalOffset = normalCount;
+		chunk.triangleOffset = triangleCount;
+		positionCount += chunk.positionCount;
+		normalCount += chunk.normalCount;
+		triangleCount += chunk.triangleCount;
+	}
+
+	std::vector<glm::vec3> positions(positionCount);
+	std::vector<glm::vec3> normals(normalCount);
+	forEachChunk(jobs, chunks, [&](OBJChunk& chunk) { parseAttributes(chunk, positions, normals); });
+
+	size_t firstVertex = out_vertices.size() / VERTEX_SIZE;
+	out_vertices.resize(out_vertices.size() + triangleCount * 3 * VERTEX_SIZE);
+	float* out = &out_vertices[firstVertex * VERTEX_SIZE];
+
+	std::atomic<bool> failed(false);
+	forEachChunk(jobs, chunks, [&](OBJChunk& chunk) {
+		if (!parseFaces(chunk, positions, normals, out))
+			failed = true;
+	});
+	if (failed) {
+		printf("File %s contains a face with missing or out of range indices.\n", path);
+		out_vertices.resize(firstVertex * VERTEX_SIZE);
+		return false;
+	}
+
+	if (out_groups) {
+		std::vector<OBJGroup> groups;
+		auto startGroup = [&](const std::string& name, size_t triangle) {
+			if (!groups.empty()) {
+				OBJGroup& previous = groups.back();
+				previous.vertexCount = firstVertex + triangle * 3 - previous.firstVertex;
+				if (previous.vertexCount == 0)
+					groups.pop_back();
+			}
+			groups.push_back({ name, firstVertex + triangle * 3, 0 });
+		};
+		startGroup("default", 0);
+		for (const OBJChunk& chunk : chunks) {
+			for (const OBJGroupStart& group : chunk.groups)
+				startGroup(group.name, chunk.triangleOffset + group.triangle);
+		}
+		startGroup("", triangleCount);
+		groups.pop_back();
+		out_groups->insert(out_groups->end(), groups.begin(), groups.end());
 	}
 	return true;
-}
\ No newline at end of file
+}